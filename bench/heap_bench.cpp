@@ -0,0 +1,181 @@
+// Priority queue microbenchmark: IndexedHeap against std::priority_queue and
+// the old BinHeap on the two access patterns the layouts use.
+//   dijkstra: single source shortest paths on a random graph, lazy deletion
+//             for std::priority_queue, decrease-key for IndexedHeap
+//   energy:   max-heap of node energies, top + neighborhood updates (HK)
+// BinHeap::update never sifts up, so it is only timed on the energy pattern
+// and its check value differs.
+#include "bin_heap.hpp"
+#include "indexed_heap.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <queue>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct Arc {
+    int dst;
+    float weight;
+};
+using Adjacency = std::vector<std::vector<Arc>>;
+
+struct EnergyItem {
+    float energy;
+    float dx = 0.0f;
+    float dy = 0.0f;
+    int node = -1;
+    bool operator<(const EnergyItem& other) const { return energy < other.energy; }
+};
+
+struct EnergyKey {
+    float operator()(const EnergyItem& e) const { return e.energy; }
+};
+
+constexpr float INF = std::numeric_limits<float>::infinity();
+
+template <typename F> double timeIt(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+Adjacency randomGraph(int V, int degree, std::mt19937& rng) {
+    Adjacency adj(V);
+    std::uniform_int_distribution<int> node(0, V - 1);
+    std::uniform_real_distribution<float> weight(1.0f, 10.0f);
+    for (int u = 0; u < V; ++u)
+        for (int k = 0; k < degree / 2; ++k) {
+            int v = node(rng);
+            float w = weight(rng);
+            adj[u].push_back({v, w});
+            adj[v].push_back({u, w});
+        }
+    return adj;
+}
+
+double dijkstraPriorityQueue(const Adjacency& adj, int src, std::vector<float>& dist) {
+    using Entry = std::pair<float, int>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<>> pq;
+    std::fill(dist.begin(), dist.end(), INF);
+    dist[src] = 0.0f;
+    pq.push({0.0f, src});
+    while (!pq.empty()) {
+        auto [d, u] = pq.top();
+        pq.pop();
+        if (d > dist[u])
+            continue;
+        for (auto [v, w] : adj[u])
+            if (d + w < dist[v]) {
+                dist[v] = d + w;
+                pq.push({dist[v], v});
+            }
+    }
+    return dist[adj.size() - 1];
+}
+
+double dijkstraIndexedHeap(const Adjacency& adj, int src, std::vector<float>& dist) {
+    IndexedHeap<float, std::identity, std::greater<>> heap(adj.size());
+    std::fill(dist.begin(), dist.end(), INF);
+    dist[src] = 0.0f;
+    heap.push(src, 0.0f);
+    while (!heap.empty()) {
+        int u = heap.pop();
+        for (auto [v, w] : adj[u])
+            if (dist[u] + w < dist[v]) {
+                dist[v] = dist[u] + w;
+                if (heap.contains(v))
+                    heap.update(v, dist[v]);
+                else
+                    heap.push(v, dist[v]);
+            }
+    }
+    return dist[adj.size() - 1];
+}
+
+// Every step takes the top node, zeroes its energy and perturbs the energy
+// of the nodes in its neighborhood, like HarellKoren::localLayout.
+double energyBinHeap(const Adjacency& adj, int steps, std::mt19937 rng) {
+    int V = adj.size();
+    std::uniform_real_distribution<float> delta(-1.0f, 1.0f);
+    BinHeap<EnergyItem> heap(V);
+    for (int v = 0; v < V; ++v)
+        heap.push({float(adj[v].size()), 0.0f, 0.0f, v});
+    double sum = 0.0;
+    for (int s = 0; s < steps; ++s) {
+        auto top = heap.top();
+        int m = top.node;
+        sum += top.energy;
+        auto node_m = heap.get(m);
+        node_m.energy = 0.0f;
+        for (auto [u, w] : adj[m]) {
+            auto node_u = heap.get(u);
+            node_u.dx += delta(rng);
+            node_u.dy += delta(rng);
+            node_u.energy = std::abs(node_u.dx) + std::abs(node_u.dy) + w;
+            heap.update(u, node_u);
+        }
+        heap.update(m, node_m);
+    }
+    return sum;
+}
+
+double energyIndexedHeap(const Adjacency& adj, int steps, std::mt19937 rng) {
+    int V = adj.size();
+    std::uniform_real_distribution<float> delta(-1.0f, 1.0f);
+    IndexedHeap<EnergyItem, EnergyKey> heap(V);
+    for (int v = 0; v < V; ++v)
+        heap.push(v, {float(adj[v].size()), 0.0f, 0.0f, v});
+    double sum = 0.0;
+    for (int s = 0; s < steps; ++s) {
+        int m = heap.topId();
+        EnergyItem& node_m = heap.at(m);
+        sum += node_m.energy;
+        node_m.energy = 0.0f;
+        for (auto [u, w] : adj[m]) {
+            EnergyItem& node_u = heap.at(u);
+            node_u.dx += delta(rng);
+            node_u.dy += delta(rng);
+            node_u.energy = std::abs(node_u.dx) + std::abs(node_u.dy) + w;
+            heap.update(u);
+        }
+        heap.update(m);
+    }
+    return sum;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int V = argc > 1 ? std::atoi(argv[1]) : 100000;
+    int degree = argc > 2 ? std::atoi(argv[2]) : 8;
+    int sources = argc > 3 ? std::atoi(argv[3]) : 20;
+    int steps = argc > 4 ? std::atoi(argv[4]) : 20 * V;
+
+    std::mt19937 rng(42);
+    Adjacency adj = randomGraph(V, degree, rng);
+    std::vector<float> dist(V);
+    std::printf("V=%d degree=%d sources=%d steps=%d\n", V, degree, sources, steps);
+
+    double check[2] = {0.0, 0.0};
+    double t[2];
+    t[0] = timeIt([&] {
+        for (int s = 0; s < sources; ++s)
+            check[0] += dijkstraPriorityQueue(adj, s, dist);
+    });
+    t[1] = timeIt([&] {
+        for (int s = 0; s < sources; ++s)
+            check[1] += dijkstraIndexedHeap(adj, s, dist);
+    });
+    std::printf("dijkstra  priority_queue %8.3f s  IndexedHeap %8.3f s  (check %g %g)\n", t[0], t[1], check[0],
+                check[1]);
+
+    t[0] = timeIt([&] { check[0] = energyBinHeap(adj, steps, rng); });
+    t[1] = timeIt([&] { check[1] = energyIndexedHeap(adj, steps, rng); });
+    std::printf("energy    BinHeap        %8.3f s  IndexedHeap %8.3f s  (check %g %g)\n", t[0], t[1], check[0],
+                check[1]);
+    return 0;
+}
@@ -0,0 +1,475 @@
+// Layout benchmark: every engine on generated graphs of increasing size and
+// on the graphs of a directory, with per-phase wall time, peak RSS, steps and
+// final stress. Results go to stdout and optionally to JSON/CSV, a previous
+// JSON/CSV run can be given as baseline to compare init + layout times
+// against; the exit code is 2 when a case got slower than the tolerance.
+// --check-kernels compares the Eades repulsion kernels the CPU supports with
+// the scalar one instead, the exit code is 2 when one is off by more than
+// the documented per pair error.
+//
+//   layout-bench [--engines fr,kk,...] [--max-nodes N] [--graphs DIR]
+//                [--repeat R] [--json FILE] [--csv FILE]
+//                [--baseline FILE] [--tolerance 0.1] [--verbose]
+//   layout-bench --check-kernels
+//
+// Stress is sum((|xi - xj| - s d_ij)^2 / d_ij^2) / pairs over the rows of up
+// to 64 sampled sources, with the scale s that minimizes it, so it does not
+// depend on the size of the drawing.
+#include "eades.hpp"
+#include "eades_kernels.hpp"
+#include "fruchterman_reingold.hpp"
+#include "graph.hpp"
+#include "graph_csr.hpp"
+#include "graph_loader.hpp"
+#include "harell_koren.hpp"
+#include "kamada_kawai.hpp"
+#include "walshaw.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double seconds(Clock::time_point since) { return std::chrono::duration<double>(Clock::now() - since).count(); }
+
+// Peak resident set in KiB. On Linux the peak is reset before every case, so
+// it covers that case only, elsewhere it is the peak of the whole process.
+void resetPeakRss() {
+    std::ofstream clear("/proc/self/clear_refs");
+    if (clear.is_open())
+        clear << "5";
+}
+
+long peakRssKiB() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+        if (line.starts_with("VmHWM:"))
+            return std::stol(line.substr(6));
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+struct GraphCase {
+    std::string family;
+    std::string param;
+    std::function<void(Graph&)> build;
+};
+
+struct Engine {
+    std::string name;
+    std::function<std::unique_ptr<Layout>()> make;
+};
+
+struct Result {
+    std::string engine;
+    std::string graph;
+    std::string param;
+    size_t nodes = 0;
+    size_t edges = 0;
+    double build = 0.0;
+    double init = 0.0;
+    double layout = 0.0;
+    double store = 0.0;
+    long rssKiB = 0;
+    int steps = 0;
+    double stress = 0.0;
+
+    std::string key() const { return engine + '/' + graph + '/' + param; }
+};
+
+double sampledStress(const Graph& g) {
+    const size_t V = g.nodes.size();
+    if (V < 2)
+        return 0.0;
+    std::vector<int> sources(V);
+    for (size_t v = 0; v < V; ++v)
+        sources[v] = v;
+    std::mt19937 rng(7);
+    std::shuffle(sources.begin(), sources.end(), rng);
+    sources.resize(std::min<size_t>(V, 64));
+
+    // e_ij / d_ij for every finite pair, the optimal scale is their mean
+    std::vector<double> ratio;
+    GraphCSR csr(g);
+    Graph::DijkstraHeap heap;
+    std::vector<float> dist(V);
+    for (int s : sources) {
+        Graph::dijkstra(csr, s, dist.data(), heap);
+        for (size_t j = 0; j < V; ++j) {
+            if (static_cast<int>(j) == s || !std::isfinite(dist[j]) || dist[j] <= 0.0f)
+                continue;
+            double dx = g.nodes[s].x - g.nodes[j].x;
+            double dy = g.nodes[s].y - g.nodes[j].y;
+            ratio.push_back(std::sqrt(dx * dx + dy * dy) / dist[j]);
+        }
+    }
+    if (ratio.empty())
+        return 0.0;
+    double scale = 0.0;
+    for (double r : ratio)
+        scale += r;
+    scale /= ratio.size();
+    if (scale <= 0.0)
+        return 1.0;
+
+    double stress = 0.0;
+    for (double r : ratio)
+        stress += (r / scale - 1.0) * (r / scale - 1.0);
+    return stress / ratio.size();
+}
+
+Result runCase(const Engine& engine, const GraphCase& gc, int repeat) {
+    Result best;
+    for (int r = 0; r < repeat; ++r) {
+        resetPeakRss();
+        Result res;
+        res.engine = engine.name;
+        res.graph = gc.family;
+        res.param = gc.param;
+
+        auto start = Clock::now();
+        Graph g;
+        gc.build(g);
+        g.randomizePos(800, 600, 1);
+        res.build = seconds(start);
+        res.nodes = g.nodes.size();
+        res.edges = g.getEdgeCount();
+
+        auto layout = engine.make();
+        start = Clock::now();
+        layout->init(g);
+        res.init = seconds(start);
+        start = Clock::now();
+        while (!layout->converged())
+            layout->step(64);
+        res.layout = seconds(start);
+        start = Clock::now();
+        layout->store(g);
+        res.store = seconds(start);
+        res.steps = layout->state().iteration;
+        res.rssKiB = peakRssKiB();
+        res.stress = sampledStress(g);
+
+        if (r == 0 || res.init + res.layout < best.init + best.layout)
+            best = res;
+    }
+    return best;
+}
+
+std::vector<Engine> makeEngines(const std::string& filter) {
+    // configs outlive the engines that keep a reference to them
+    static EadesConf eades;
+    static FruchtermanReingoldConf fr;
+    static KamadaKawaiConf kk;
+    static HarellKorenConf hk;
+    static WalshawConf walshaw;
+    walshaw.mx = 800;
+    walshaw.my = 600;
+
+    std::vector<Engine> all = {
+        {"fr", [] { return std::make_unique<FruchtermanReingold>(fr); }},
+        {"eades", [] { return std::make_unique<Eades>(eades); }},
+        {"walshaw", [] { return std::make_unique<Walshaw>(walshaw); }},
+        {"kk", [] { return std::make_unique<KamadaKawai>(kk); }},
+        {"hk", [] { return std::make_unique<HarellKoren>(hk); }},
+    };
+    if (filter.empty())
+        return all;
+    std::vector<Engine> chosen;
+    std::stringstream ss(filter);
+    std::string name;
+    while (std::getline(ss, name, ',')) {
+        auto it = std::find_if(all.begin(), all.end(), [&](const Engine& e) { return e.name == name; });
+        if (it == all.end())
+            throw std::runtime_error("unknown engine " + name);
+        chosen.push_back(*it);
+    }
+    return chosen;
+}
+
+std::vector<GraphCase> makeCases(size_t maxNodes, const std::string& dir) {
+    std::vector<GraphCase> cases;
+    for (int n = 8; static_cast<size_t>(n * n) <= maxNodes; n *= 2)
+        cases.push_back(
+            {"grid", std::to_string(n) + "x" + std::to_string(n), [n](Graph& g) { buildGrid(g, n, n); }});
+    for (int n = 8; static_cast<size_t>(2 * n * n) <= maxNodes; n *= 2)
+        cases.push_back({"torus", std::to_string(n) + "x" + std::to_string(2 * n),
+                         [n](Graph& g) { buildTorus(g, n, 2 * n); }});
+    // depth d has (3^(d+1) + 3) / 2 nodes
+    for (int d = 2, V = 15; static_cast<size_t>(V) <= maxNodes; ++d, V = 3 * V - 3)
+        cases.push_back({"sierpinski", std::to_string(d), [d](Graph& g) { buildSierpinski(g, d); }});
+
+    if (dir.empty() || !std::filesystem::is_directory(dir))
+        return cases;
+    std::vector<std::filesystem::path> files;
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+        std::string ext = entry.path().extension().string();
+        if (ext == ".mtx" || ext == ".src")
+            files.push_back(entry.path());
+    }
+    std::sort(files.begin(), files.end());
+    // no .glc caches in the graph directory, build times always measure a parse
+    for (const auto& path : files) {
+        size_t nodes = headerNodeCount(path.string());
+        if (nodes == 0) {
+            Graph probe;
+            loadGraphPath(probe, path.string(), false);
+            nodes = probe.nodes.size();
+        }
+        if (nodes > maxNodes) {
+            std::cout << "skip " << path.string() << ": " << nodes << " nodes\n";
+            continue;
+        }
+        cases.push_back({"file", path.filename().string(),
+                         [p = path.string()](Graph& g) { loadGraphPath(g, p, false); }});
+    }
+    return cases;
+}
+
+void writeJson(const std::vector<Result>& results, const std::string& path) {
+    std::ofstream out(path);
+    out << "[\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        out << "  {\"engine\": \"" << r.engine << "\", \"graph\": \"" << r.graph << "\", \"param\": \"" << r.param
+            << "\", \"nodes\": " << r.nodes << ", \"edges\": " << r.edges << ", \"build_s\": " << r.build
+            << ", \"init_s\": " << r.init << ", \"layout_s\": " << r.layout << ", \"store_s\": " << r.store
+            << ", \"peak_rss_kib\": " << r.rssKiB << ", \"steps\": " << r.steps << ", \"stress\": " << r.stress
+            << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "]\n";
+}
+
+// Cases faster than this in the baseline are reported but never flagged
+constexpr double MIN_COMPARED_SECONDS = 0.01;
+
+const char* CSV_HEADER =
+    "engine,graph,param,nodes,edges,build_s,init_s,layout_s,store_s,peak_rss_kib,steps,stress";
+
+void writeCsv(const std::vector<Result>& results, const std::string& path) {
+    std::ofstream out(path);
+    out << CSV_HEADER << "\n";
+    for (const Result& r : results)
+        out << r.engine << ',' << r.graph << ',' << r.param << ',' << r.nodes << ',' << r.edges << ',' << r.build
+            << ',' << r.init << ',' << r.layout << ',' << r.store << ',' << r.rssKiB << ',' << r.steps << ','
+            << r.stress << "\n";
+}
+
+// Reads back what writeJson/writeCsv wrote: key -> init + layout seconds
+std::map<std::string, double> readBaseline(const std::string& path) {
+    std::ifstream in(path);
+    if (!in.is_open())
+        throw std::runtime_error("failed to open baseline " + path);
+    std::map<std::string, double> times;
+    std::string line;
+    bool json = path.ends_with(".json");
+    auto field = [](const std::string& line, const std::string& key) {
+        size_t at = line.find("\"" + key + "\": ");
+        if (at == std::string::npos)
+            return std::string();
+        at += key.size() + 4;
+        if (line[at] == '"')
+            return line.substr(at + 1, line.find('"', at + 1) - at - 1);
+        return line.substr(at, line.find_first_of(",}", at) - at);
+    };
+    while (std::getline(in, line)) {
+        if (json) {
+            if (line.find("\"engine\"") == std::string::npos)
+                continue;
+            std::string key = field(line, "engine") + '/' + field(line, "graph") + '/' + field(line, "param");
+            times[key] = std::stod(field(line, "init_s")) + std::stod(field(line, "layout_s"));
+        } else {
+            if (line.empty() || line == CSV_HEADER)
+                continue;
+            std::vector<std::string> cols;
+            std::stringstream ss(line);
+            std::string col;
+            while (std::getline(ss, col, ','))
+                cols.push_back(col);
+            if (cols.size() < 8)
+                continue;
+            times[cols[0] + '/' + cols[1] + '/' + cols[2]] = std::stod(cols[6]) + std::stod(cols[7]);
+        }
+    }
+    return times;
+}
+
+// Per pair: node 0 against 16 copies of one other node, copies push each
+// other with dx = dy = 0, so every vector lane computes the same pair and
+// fxs[1] holds that force alone. Sums: a random layout, the deviation at a
+// node relative to the sum of its pair force magnitudes, which also carries
+// the different summation orders.
+int checkKernels() {
+    constexpr double PAIR_TOLERANCE = 1e-6;
+    constexpr size_t COPIES = 16;
+    constexpr size_t N = 2000;
+    const std::vector<EadesKernelInfo> kernels = availableEadesRepulsion();
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    std::vector<std::vector<float>> pairFx(kernels.size()), pairFy(kernels.size());
+    for (int trial = 0; trial < 10000; ++trial) {
+        float d = std::pow(10.0f, -2.0f + 6.0f * unit(rng));
+        float a = 6.2831853f * unit(rng);
+        std::vector<float> xs(COPIES + 1, d * std::cos(a)), ys(COPIES + 1, d * std::sin(a));
+        xs[0] = ys[0] = 0.0f;
+        for (size_t k = 0; k < kernels.size(); ++k) {
+            std::vector<float> fx(COPIES + 1, 0.0f), fy(COPIES + 1, 0.0f);
+            kernels[k].kernel(xs.data(), ys.data(), fx.data(), fy.data(), COPIES + 1, 1.0f);
+            pairFx[k].push_back(fx[1]);
+            pairFy[k].push_back(fy[1]);
+        }
+    }
+
+    std::vector<float> xs(N), ys(N);
+    for (size_t i = 0; i < N; ++i) {
+        xs[i] = 1000.0f * unit(rng);
+        ys[i] = 1000.0f * unit(rng);
+    }
+    std::vector<double> magnitude(N, 0.0);
+    for (size_t i = 0; i < N; ++i) {
+        for (size_t j = i + 1; j < N; ++j) {
+            double dx = xs[i] - xs[j], dy = ys[i] - ys[j];
+            double f = 1.0 / std::max(dx * dx + dy * dy, double(EPSILON));
+            magnitude[i] += f;
+            magnitude[j] += f;
+        }
+    }
+    std::vector<std::vector<float>> sumFx(kernels.size()), sumFy(kernels.size());
+    for (size_t k = 0; k < kernels.size(); ++k) {
+        sumFx[k].assign(N, 0.0f);
+        sumFy[k].assign(N, 0.0f);
+        kernels[k].kernel(xs.data(), ys.data(), sumFx[k].data(), sumFy[k].data(), N, 1.0f);
+    }
+
+    int failures = 0;
+    std::printf("%-8s %14s %14s\n", "kernel", "max_pair_err", "max_sum_dev");
+    for (size_t k = 0; k < kernels.size(); ++k) {
+        double pairErr = 0.0, sumDev = 0.0;
+        for (size_t t = 0; t < pairFx[0].size(); ++t) {
+            double ref = std::hypot(pairFx[0][t], pairFy[0][t]);
+            double err = std::hypot(pairFx[k][t] - pairFx[0][t], pairFy[k][t] - pairFy[0][t]);
+            pairErr = std::max(pairErr, err / ref);
+        }
+        for (size_t i = 0; i < N; ++i) {
+            double dev = std::hypot(sumFx[k][i] - sumFx[0][i], sumFy[k][i] - sumFy[0][i]);
+            sumDev = std::max(sumDev, dev / magnitude[i]);
+        }
+        bool bad = pairErr > PAIR_TOLERANCE;
+        failures += bad;
+        std::printf("%-8s %14.3g %14.3g%s\n", kernels[k].name, pairErr, sumDev, bad ? " OVER TOLERANCE" : "");
+    }
+    return failures;
+}
+
+int run(int argc, char** argv) {
+    std::string engines, json, csv, baseline;
+    std::string dir = "graphs";
+    size_t maxNodes = 2000;
+    int repeat = 1;
+    double tolerance = 0.1;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc)
+                throw std::runtime_error(arg + " needs a value");
+            return argv[++i];
+        };
+        if (arg == "--engines")
+            engines = next();
+        else if (arg == "--max-nodes")
+            maxNodes = std::stoul(next());
+        else if (arg == "--graphs")
+            dir = next();
+        else if (arg == "--repeat")
+            repeat = std::max(1, std::stoi(next()));
+        else if (arg == "--json")
+            json = next();
+        else if (arg == "--csv")
+            csv = next();
+        else if (arg == "--baseline")
+            baseline = next();
+        else if (arg == "--tolerance")
+            tolerance = std::stod(next());
+        else if (arg == "--verbose")
+            verbose = true;
+        else if (arg == "--check-kernels")
+            return checkKernels() > 0 ? 2 : 0;
+        else
+            throw std::runtime_error("unknown argument " + arg);
+    }
+
+    // the engines log every level and iteration
+    std::streambuf* clogBuf = std::clog.rdbuf();
+    if (!verbose)
+        std::clog.rdbuf(nullptr);
+
+    std::map<std::string, double> base;
+    if (!baseline.empty())
+        base = readBaseline(baseline);
+
+    std::vector<Engine> engineList = makeEngines(engines);
+    std::vector<GraphCase> cases = makeCases(maxNodes, dir);
+    std::vector<Result> results;
+    int regressions = 0;
+    std::printf("%-8s %-10s %-10s %7s %9s %9s %9s %10s %8s %8s %s\n", "engine", "graph", "param", "nodes",
+                "build_s", "init_s", "layout_s", "rss_kib", "steps", "stress", base.empty() ? "" : "vs baseline");
+    for (const Engine& engine : engineList) {
+        for (const GraphCase& gc : cases) {
+            Result r = runCase(engine, gc, repeat);
+            std::printf("%-8s %-10s %-10s %7zu %9.4f %9.4f %9.4f %10ld %8d %8.4f", r.engine.c_str(),
+                        r.graph.c_str(), r.param.c_str(), r.nodes, r.build, r.init, r.layout, r.rssKiB, r.steps,
+                        r.stress);
+            auto it = base.find(r.key());
+            if (it != base.end() && it->second > 0.0) {
+                double ratio = (r.init + r.layout) / it->second;
+                // runs of a few milliseconds are mostly timer and cache noise
+                bool slower = ratio > 1.0 + tolerance && it->second >= MIN_COMPARED_SECONDS;
+                regressions += slower;
+                std::printf(" %6.2fx%s", ratio, slower ? " REGRESSION" : "");
+            }
+            std::printf("\n");
+            std::fflush(stdout);
+            results.push_back(r);
+        }
+    }
+    std::clog.rdbuf(clogBuf);
+
+    if (!json.empty())
+        writeJson(results, json);
+    if (!csv.empty())
+        writeCsv(results, csv);
+    if (!base.empty())
+        std::printf("%d regression(s) over %.0f%% against %s\n", regressions, tolerance * 100, baseline.c_str());
+    return regressions > 0 ? 2 : 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    try {
+        return run(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << "error: " << e.what() << '\n';
+        return 1;
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <functional>
+#include <string>
+
+// .gz and .zst files, by extension. Support for each is a build option,
+// reading a format that was not built in throws std::runtime_error.
+bool isCompressed(const std::string& path);
+// Extension of the decompressed file, "a.mtx.gz" -> ".mtx"
+std::string innerExtension(const std::string& path);
+
+// Decompresses path on a worker thread, which hands chunk buffers to the
+// calling thread through a bounded queue, so reading, decompression and
+// onLines overlap without a temporary file. onLines gets [begin, end)
+// views of whole lines (the last one may lack its '\n'), valid during the
+// call only. Errors of either side are rethrown on the calling thread.
+void readCompressedLines(const std::string& path,
+                         const std::function<void(const char*, const char*)>& onLines);
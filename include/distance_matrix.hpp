@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// V x V distance matrix in a single allocation. Symmetric matrices keep only
+// the upper triangle (diagonal included). Hop counts of uniform weight graphs
+// can be stored as uint8/uint16 codes, d = code * unit, with the largest code
+// reserved for unreachable pairs.
+class DistanceMatrix {
+
+  public:
+    enum class Storage { Float, U16, U8 };
+
+    DistanceMatrix() = default;
+    DistanceMatrix(size_t n, bool symmetric, Storage storage = Storage::Float, float unit = 1.0f);
+
+    size_t size() const { return n_; }
+    bool symmetric() const { return symmetric_; }
+    Storage storage() const { return storage_; }
+    float unit() const { return unit_; }
+    size_t bytes() const;
+
+    float operator()(size_t i, size_t j) const {
+        const size_t k = index(i, j);
+        switch (storage_) {
+        case Storage::U16:
+            return decode(u16_[k], std::numeric_limits<uint16_t>::max());
+        case Storage::U8:
+            return decode(u8_[k], std::numeric_limits<uint8_t>::max());
+        default:
+            return f32_[k];
+        }
+    }
+
+    // For quantized storage d must be a multiple of unit() or infinity
+    void set(size_t i, size_t j, float d);
+    // Decodes row i into out[0 .. size())
+    void row(size_t i, float* out) const;
+    // Largest finite entry, 0 if there is none
+    float maxFinite() const;
+
+    // Largest hop count a quantized storage can hold
+    static size_t maxHops(Storage storage);
+
+  private:
+    size_t n_ = 0;
+    bool symmetric_ = false;
+    Storage storage_ = Storage::Float;
+    float unit_ = 1.0f;
+    // only the vector matching storage_ is allocated
+    std::vector<float> f32_;
+    std::vector<uint16_t> u16_;
+    std::vector<uint8_t> u8_;
+
+    size_t index(size_t i, size_t j) const {
+        if (!symmetric_)
+            return i * n_ + j;
+        if (i > j)
+            std::swap(i, j);
+        return i * (2 * n_ - i + 1) / 2 + (j - i);
+    }
+    float decode(uint32_t code, uint32_t inf) const {
+        return code == inf ? std::numeric_limits<float>::infinity() : static_cast<float>(code) * unit_;
+    }
+    template <typename T> void decodeRow(const std::vector<T>& data, size_t i, float* out) const;
+};
@@ -1,6 +1,9 @@
 #pragma once
 #include "graph.hpp"
+#include "graph_csr.hpp"
 #include "layout.hpp"
+#include "eades_kernels.hpp"
+#include "layout_buffers.hpp"
 #include <cmath>
 
 struct EadesConf {
@@ -11,18 +14,25 @@ struct EadesConf {
     float c2 = 100.0f;
     float c3 = 1.0f;
     float c4 = 0.1f;
+    // Hand vectorized repulsion (AVX2 / AVX-512) when the CPU supports it
+    bool simd = true;
 };
 
 class Eades : public Layout {
 
   private:
     const EadesConf& cfg_;
+    GraphCSR csr_;
+    LayoutBuffers buf_;
+    EadesRepulsionKernel repulsion_ = eadesRepulsionScalar;
 
-    float repelForce(float d);
     float attractForce(float d);
 
   public:
     ~Eades() override = default;
     explicit Eades(const EadesConf& cfg) : cfg_(cfg) {}
-    void apply(Graph& g) override;
+    void init(const Graph& g) override;
+    float step(int n = 1) override;
+    bool converged() const override;
+    void store(Graph& g) const override;
 };
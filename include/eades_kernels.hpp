@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Accumulates the Eades repulsion c3 / d^2 over all pairs i < j into fxs/fys.
+// The vector kernels use rsqrt with one Newton step; per pair forces match
+// the scalar kernel within a relative error of 1e-6 (sums may differ more
+// due to summation order).
+using EadesRepulsionKernel = void (*)(const float* xs, const float* ys, float* fxs, float* fys, size_t n,
+                                      float c3);
+
+void eadesRepulsionScalar(const float* xs, const float* ys, float* fxs, float* fys, size_t n, float c3);
+void eadesRepulsionAvx2(const float* xs, const float* ys, float* fxs, float* fys, size_t n, float c3);
+void eadesRepulsionAvx512(const float* xs, const float* ys, float* fxs, float* fys, size_t n, float c3);
+
+struct EadesKernelInfo {
+    const char* name;
+    EadesRepulsionKernel kernel;
+};
+// Kernels the running CPU supports, scalar first, best last
+std::vector<EadesKernelInfo> availableEadesRepulsion();
+// Best kernel supported by the running CPU
+EadesRepulsionKernel selectEadesRepulsion(const char** name = nullptr);
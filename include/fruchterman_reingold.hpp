@@ -1,12 +1,22 @@
 #pragma once
 #include "graph.hpp"
+#include "graph_csr.hpp"
 #include "layout.hpp"
+#include "layout_buffers.hpp"
+#include "quadtree.hpp"
+#include "spatial_grid.hpp"
 #include <cmath>
+
+enum class RepulsionMode { Exact, BarnesHut, Grid };
+
 struct FruchtermanReingoldConf {
     float mx = 800;
     float my = 600;
     int max_iter = 500;
     float C = 0.5;
+    RepulsionMode mode = RepulsionMode::Exact;
+    // Barnes-Hut opening angle, 0 is exact
+    float theta = 0.5f;
 };
 
 class FruchtermanReingold : public Layout {
@@ -16,17 +26,26 @@ class FruchtermanReingold : public Layout {
     float A_;
     float K_;
     float T_;
-    int I_ = 0;
+    GraphCSR csr_;
+    LayoutBuffers buf_;
+    QuadTree tree_;
+    SpatialGrid grid_;
 
     float fa(float d, float k) { return (d * d) / k; }
     float fr(float d, float k) { return (k * k) / d; }
     float cool(float t) { return t * 0.99f; };
-    void updatePositions(Graph& g);
-    void computeAttractiveForces(Graph& g);
-    void computeRepulsiveForces(Graph& g);
+    // returns the mean displacement
+    float updatePositions();
+    void computeAttractiveForces();
+    void computeRepulsiveForces();
+    void computeRepulsiveForcesBarnesHut();
+    void computeRepulsiveForcesGrid();
 
   public:
     ~FruchtermanReingold() override = default;
     explicit FruchtermanReingold(const FruchtermanReingoldConf& cfg) : cfg_(cfg) {}
-    void apply(Graph& g) override;
+    void init(const Graph& g) override;
+    float step(int n = 1) override;
+    bool converged() const override;
+    void store(Graph& g) const override;
 };
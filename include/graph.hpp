@@ -1,11 +1,17 @@
 #pragma once
+#include "distance_matrix.hpp"
+#include "indexed_heap.hpp"
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <ctime>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 struct Edge;
+class GraphCSR;
 struct Node {
     int id;
     float x = 0, y = 0;
@@ -22,25 +28,52 @@ class Graph {
   public:
     std::vector<Node> nodes;
     std::vector<std::vector<NodeAdj>> adj;
+    // Only filled once ids stop being dense, while denseIds holds the id
+    // of every node is its index
     std::unordered_map<int, size_t> idToIndex;
+    bool denseIds = true;
     bool directed = false;
+    // Versions come from one process-wide counter, so two graphs only share
+    // one when they are copies of each other. Engines key their caches on it.
+    // Renewed whenever nodes or edges are added or removed
+    uint64_t topologyVersion = nextVersion();
+    // Renewed whenever node positions are written as a whole, by layouts,
+    // loaders and the helpers below
+    uint64_t positionVersion = nextVersion();
+
+    static uint64_t nextVersion();
 
     Graph(bool directed = false) : directed(directed) {}
 
     size_t getEdgeCount();
     size_t addNode(const int id);
+    size_t indexOf(const int id) const;
     void addEdge(const int src, const int dest, float weight = 1.0f);
     std::vector<int> getNeighbords(const int n);
     void print();
     void randomizePos(float w, float h);
+    // Reproducible positions for a given seed
+    void randomizePos(float w, float h, unsigned seed);
     void gridLayout(float width, float height, int cols = 0);
     void resetForces();
 
+    // Min-heap of tentative distances with decrease-key, ids are nodes
+    using DijkstraHeap = IndexedHeap<float, std::identity, std::greater<>>;
+
     void dijkstra(int src, std::vector<float>& dist);
-    std::vector<std::vector<float>> computeAllPairsShortestPaths();
+    static void dijkstra(const GraphCSR& csr, int src, float* dist, DijkstraHeap& heap);
+    // Uniform integer weights are stored as uint8/uint16 hop counts when
+    // quantize is set and the diameter fits
+    // Sources left once cancel is set are skipped, the result is then
+    // incomplete and must be discarded
+    DistanceMatrix computeAllPairsShortestPaths(bool quantize = true,
+                                                const std::atomic<bool>* cancel = nullptr) const;
     void clear() {
         nodes.clear();
         adj.clear();
         idToIndex.clear();
+        denseIds = true;
+        topologyVersion = nextVersion();
+        positionVersion = nextVersion();
     }
 };
@@ -0,0 +1,41 @@
+#pragma once
+#include "graph.hpp"
+#include <cstddef>
+#include <vector>
+
+// Collects edges and builds a Graph in one pass, for loaders and generators.
+// Ids that already fall in [0, n) become node indices directly, anything
+// else is remapped to indices in id order. Adjacency is built with a
+// counting sort into one buffer, dropping self-loops and repeated edges (the
+// first weight wins), and every row is then copied out with its exact size.
+class GraphBuilder {
+
+  public:
+    struct Edge {
+        int src;
+        int dst;
+        float weight = 1.0f;
+    };
+
+    // Nodes 0..n-1 exist even when no edge touches them
+    void setNodeCount(size_t n) { nodeCount_ = n; }
+    void reserve(size_t edges);
+
+    void addEdge(int src, int dst, float weight = 1.0f) {
+        if (parts_.empty())
+            parts_.emplace_back();
+        parts_.back().push_back({src, dst, weight});
+    }
+    // Takes a whole batch, e.g. the edges one loader thread parsed
+    void addEdges(std::vector<Edge>&& edges) { parts_.push_back(std::move(edges)); }
+
+    size_t edgeCount() const;
+
+    // Replaces the nodes and edges of g, g.directed decides whether every
+    // edge is added in both directions. The builder is empty afterwards.
+    void build(Graph& g);
+
+  private:
+    size_t nodeCount_ = 0;
+    std::vector<std::vector<Edge>> parts_;
+};
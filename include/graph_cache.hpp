@@ -0,0 +1,63 @@
+#pragma once
+#include "graph.hpp"
+#include "mapped_file.hpp"
+#include <cstdint>
+#include <span>
+#include <string>
+
+// Binary graph file, read through a memory mapping without copies:
+//
+//   header   magic "GLCACHE", version, flags, node and edge counts and a
+//            hash of every section below
+//   offsets  uint64[V + 1], CSR row starts
+//   dst      int32[E], weight float[E]
+//   ids      int32[V], only when node ids are not the indices
+//   xy       float[2V], x and y interleaved, only when saved
+//
+// Sections start 8-byte aligned. Files of another version, truncated or
+// failing the hash are rejected with std::runtime_error.
+class GraphCache {
+
+  public:
+    static constexpr uint32_t VERSION = 1;
+
+    explicit GraphCache(const std::string& path);
+
+    size_t nodeCount() const { return header().nodes; }
+    size_t edgeCount() const { return header().edges; }
+    bool directed() const { return header().flags & DIRECTED; }
+
+    std::span<const uint64_t> offsets() const { return offsets_; }
+    std::span<const int32_t> dst() const { return dst_; }
+    std::span<const float> weight() const { return weight_; }
+    // Empty when every id is its index
+    std::span<const int32_t> ids() const { return ids_; }
+    // Empty when positions were not saved
+    std::span<const float> positions() const { return xy_; }
+
+    // Replaces the contents of g, positions included when present
+    void toGraph(Graph& g) const;
+
+    // Writes to a temporary file next to path and renames it into place
+    static void write(const Graph& g, const std::string& path, bool positions = false);
+
+  private:
+    enum Flags : uint32_t { DIRECTED = 1, IDS = 2, POSITIONS = 4 };
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t flags;
+        uint64_t nodes;
+        uint64_t edges;
+        uint64_t hash;
+    };
+
+    MappedFile file_;
+    std::span<const uint64_t> offsets_;
+    std::span<const int32_t> dst_;
+    std::span<const float> weight_;
+    std::span<const int32_t> ids_;
+    std::span<const float> xy_;
+
+    const Header& header() const { return *reinterpret_cast<const Header*>(file_.data()); }
+};
@@ -0,0 +1,41 @@
+#pragma once
+#include "graph.hpp"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+struct CanonicalEdge {
+    int src;
+    int dst;
+    float weight;
+};
+
+// Read-only compressed sparse row snapshot of a Graph. Neighbors of v are
+// dst[offsets[v] .. offsets[v + 1]). Rebuild it when the topology changes.
+class GraphCSR {
+
+  public:
+    std::vector<size_t> offsets;
+    std::vector<int> dst;
+    std::vector<float> weight;
+    // Each undirected edge once (src <= dst), every arc for directed graphs
+    std::vector<CanonicalEdge> edges;
+    bool directed = false;
+    uint64_t topologyVersion = 0;
+
+    GraphCSR() = default;
+    explicit GraphCSR(const Graph& g, bool canonicalEdges = false) { build(g, canonicalEdges); }
+
+    void build(const Graph& g, bool canonicalEdges = false);
+
+    size_t nodeCount() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+    size_t arcCount() const { return dst.size(); }
+    size_t degree(size_t v) const { return offsets[v + 1] - offsets[v]; }
+
+    std::span<const int> neighbors(size_t v) const {
+        return {dst.data() + offsets[v], dst.data() + offsets[v + 1]};
+    }
+    std::span<const float> weights(size_t v) const {
+        return {weight.data() + offsets[v], weight.data() + offsets[v + 1]};
+    }
+};
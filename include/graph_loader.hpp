@@ -1,111 +1,48 @@
+#pragma once
 #include "graph.hpp"
-#include <filesystem>
-#include <fstream>
-#include <iostream>
-#include <sstream>
-
-inline void loadSotch(Graph& g, const std::string& path) {
-    std::clog << "Load .src file: " << path << "\n";
-    std::ifstream file(path);
-    if (!file.is_open()) {
-        throw std::runtime_error("failed to open file");
-    }
-
-    int numNodes, numEdges;
-    file >> numNodes >> numEdges;
-    g.nodes.reserve(numNodes);
-    g.adj.reserve(numNodes);
-
-    std::string line;
-    std::getline(file, line);
-
-    while (std::getline(file, line)) {
-        if (line.empty())
-            continue;
-        std::istringstream ss(line);
-
-        int nodeId;
-        ss >> nodeId;
-
-        int weight, neighbor;
-
-        if (!(ss >> weight >> neighbor))
-            continue;
-
-        while (ss >> weight >> neighbor) {
-            g.addEdge(nodeId, neighbor, weight);
-        }
-    }
-    file.close();
-}
-inline void loadMtx(Graph& g, const std::string& path) {
-    std::clog << "Load .mtx file: " << path << "\n";
-
-    std::ifstream file(path);
-    if (!file.is_open()) {
-        throw std::runtime_error("failed to open file");
-    }
-    std::string str;
-    while (std::getline(file, str)) {
-
-        if (str.empty())
-            continue;
-        if (!str.starts_with("%")) {
-            break;
-        }
-    }
-    std::istringstream ss(str);
-    int rows = 0, cols = 0, nnz;
-
-    ss >> rows >> cols >> nnz;
-
-    g.nodes.reserve(rows);
-    g.adj.reserve(cols);
-
-    while (std::getline(file, str)) {
-        if (str.empty() || str.starts_with("%")) {
-            continue;
-        }
-        std::istringstream ss(str);
-        int r, c;
-        double v = 1.0f;
-        if (!(ss >> r >> c)) {
-            continue;
-        }
-        g.addEdge(r - 1, c - 1, v);
-    }
-    file.close();
-}
-inline void loadGraphPath(Graph& g, const std::string& path) {
-    std::string ext = std::filesystem::path(path).extension().string();
-    if (ext == ".mtx") {
-        loadMtx(g, path);
-    } else if (ext == ".src") {
-        loadSotch(g, path);
-    } else {
-        std::clog << "invaid file type " << ext << "\n";
-    }
-}
+#include "graph_builder.hpp"
+#include <string>
+
+// Both parsers map the file and split it across the workers at line
+// boundaries, then build g with a GraphBuilder (replacing its contents).
+// Unreadable files and bad headers throw std::runtime_error, g is then left
+// as it was.
+// .gz and .zst files are decompressed on a second thread while the
+// previous chunk is being parsed.
+void loadSotch(Graph& g, const std::string& path);
+void loadMtx(Graph& g, const std::string& path);
+
+// Loads a .mtx, .src or .glc file, the text ones optionally compressed. Text files are cached as <path>.glc
+// next to them when cache is set, later loads map that file instead as
+// long as it is not older than the source. Throws like the parsers, and on
+// unsupported extensions.
+void loadGraphPath(Graph& g, const std::string& path, bool cache = true);
+
+// Node count a graph file declares, read from its header without parsing the
+// edges, 0 when a .mtx has no size line. The .src count is only a hint, the
+// loader sizes the graph by the largest id.
+size_t headerNodeCount(const std::string& path);
+
+// Generators replace the contents of g, node ids are the indices
 
 // Build a grid graph
 inline void buildGrid(Graph& g, int mx, int my) {
+    GraphBuilder builder;
+    builder.setNodeCount(mx * my);
+    builder.reserve(2 * mx * my);
     for (int y = 0; y < my; ++y) {
         for (int x = 0; x < mx; ++x) {
             int node = y * mx + x;
             if (x + 1 < mx)
-                g.addEdge(node, node + 1);
+                builder.addEdge(node, node + 1);
             if (y + 1 < my)
-                g.addEdge(node, node + mx);
+                builder.addEdge(node, node + mx);
         }
     }
+    builder.build(g);
 }
 
-void buildSierpinskiRec(Graph& g, int a, int b, int c, int depth, int& nextNodeId);
-inline void buildSierpinski(Graph& g, int depth) {
-    int node_id = 2;
-    buildSierpinskiRec(g, 0, 1, 2, depth, node_id);
-}
-inline void buildSierpinskiRec(Graph& g, int a, int b, int c, int depth, int& nextNodeId) {
+inline void buildSierpinskiRec(GraphBuilder& g, int a, int b, int c, int depth, int& nextNodeId) {
     if (depth == 0) {
         g.addEdge(a, b);
         g.addEdge(b, c);
@@ -121,12 +58,18 @@ inline void buildSierpinskiRec(Graph& g, int a, int b, int c, int depth, int& ne
     buildSierpinskiRec(g, ab, b, bc, depth - 1, nextNodeId);
     buildSierpinskiRec(g, ca, bc, c, depth - 1, nextNodeId);
 }
+inline void buildSierpinski(Graph& g, int depth) {
+    GraphBuilder builder;
+    int node_id = 2;
+    buildSierpinskiRec(builder, 0, 1, 2, depth, node_id);
+    builder.setNodeCount(node_id + 1);
+    builder.build(g);
+}
 
 inline void buildTorus(Graph& g, int n, int m) {
-
-    for (int i = 0; i < n * m; ++i) {
-        g.addNode(i);
-    }
+    GraphBuilder builder;
+    builder.setNodeCount(n * m);
+    builder.reserve(2 * n * m);
 
     for (int i = 0; i < n; ++i) {
         for (int j = 0; j < m; ++j) {
@@ -134,8 +77,9 @@ inline void buildTorus(Graph& g, int n, int m) {
             int right = i * m + (j + 1) % m;
             int down = ((i + 1) % n) * m + j;
 
-            g.addEdge(current, right);
-            g.addEdge(current, down);
+            builder.addEdge(current, right);
+            builder.addEdge(current, down);
         }
     }
+    builder.build(g);
 }
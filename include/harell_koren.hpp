@@ -1,6 +1,10 @@
 #pragma once
 #include "graph.hpp"
+#include "graph_csr.hpp"
 #include "layout.hpp"
+#include "layout_buffers.hpp"
+#include "spring_model.hpp"
+#include <span>
 
 struct HarellKorenConf {
     float mx = 800.0f;
@@ -12,12 +16,18 @@ struct HarellKorenConf {
     float K = 1.0f;
 };
 
-struct NodeEnergy {
-    float energy;
-    float dx = 0.0f;
-    float dy = 0.0f;
-    int node = -1;
-    bool operator<(const NodeEnergy& other) const { return energy < other.energy; }
+// Radius-bounded neighborhoods of every node in one CSR buffer. Each list is
+// ordered by distance, so a smaller radius takes a prefix of it and a larger
+// one continues from the nodes already found.
+struct Neighborhoods {
+    std::vector<size_t> offsets;
+    std::vector<int> nodes;
+    // entries of each list within the current radius
+    std::vector<size_t> counts;
+    // radius the lists were grown to, < 0 before the first build
+    float grown = -1.0f;
+
+    std::span<const int> operator[](size_t v) const { return {nodes.data() + offsets[v], counts[v]}; }
 };
 
 class HarellKoren : public Layout {
@@ -25,32 +35,55 @@ class HarellKoren : public Layout {
   private:
     const HarellKorenConf& cfg_;
 
+    // greedy k-centers, extended level by level. centerDist_ is the distance
+    // of every node to its closest center, -1 marks the centers themselves
     std::vector<int> centers_;
-    std::vector<std::vector<float>> dist_;
-    std::vector<std::vector<float>> L_;
-    std::vector<std::vector<float>> K_;
+    AlignedVector<float> centerDist_;
+    AlignedVector<float> row_;
+    DistanceMatrix dist_;
+    uint64_t distVersion_ = 0;
+    SpringModel springs_;
+    GraphCSR csr_;
+    Neighborhoods neighborhoods_;
+    // node energies of the current level, the next node to move on top
+    EnergyHeap heap_;
+    // positions being laid out
+    Graph work_;
+    // current level of the multiscale loop, its k and node moves so far
+    int level_ = 0;
+    int levelCount_ = 0;
+    size_t levelSize_ = 0;
+    int levelIter_ = 0;
+    // false until beginLevel() ran for level_
+    bool levelReady_ = false;
+
+    // k-centers, radius, neighborhoods and energies of the next level
+    void beginLevel();
+    // Newton step for the node with the largest energy
+    void moveNode(Graph& g, const DistanceMatrix& dist);
 
   public:
     explicit HarellKoren(const HarellKorenConf& cfg) : cfg_(cfg) {}
     ~HarellKoren() override = default;
-    void apply(Graph& g) override;
+    // One node move per step, max_iter * V moves per level. The setup of
+    // each level after the first is a step() call of its own.
+    void init(const Graph& g) override;
+    float step(int n = 1) override;
+    bool converged() const override;
+    void store(Graph& g) const override;
 
-    std::vector<int> kCenters(const Graph& g, const std::vector<std::vector<float>>& dist, size_t k);
-    void computeLAndK(const std::vector<std::vector<float>>& dist, float L0, float k);
+    const std::vector<int>& kCenters(const DistanceMatrix& dist, size_t k);
 
-    float computeRadius(const std::vector<int>& centers, const std::vector<std::vector<float>>& dist,
+    float computeRadius(const std::vector<int>& centers, const DistanceMatrix& dist,
                         float Rad);
 
-    void localLayout(Graph& g, const std::vector<std::vector<float>>& dist, float radius);
-
-    NodeEnergy computeDeltaK(const Graph& g, int v, const std::vector<std::vector<float>>& dist,
-                             const std::vector<int>& neighborhood);
-    std::vector<std::vector<int>> computeKNeighborhoods(const Graph& g,
-                                                        const std::vector<std::vector<float>>& dist, int k);
+    NodeEnergy computeDeltaK(const Graph& g, int v, const DistanceMatrix& dist,
+                             std::span<const int> neighborhood);
+    const Neighborhoods& computeKNeighborhoods(const DistanceMatrix& dist, int k);
 
-    std::vector<float> computeEnergyDeltaAllNodes(Graph& g, const std::vector<std::vector<float>>& d,
-                                                  const std::vector<std::vector<int>>& neighborhoods);
+    std::vector<float> computeEnergyDeltaAllNodes(Graph& g, const DistanceMatrix& d,
+                                                  const Neighborhoods& neighborhoods);
 
-    void noise(Graph& g, const std::vector<int>& centers, const std::vector<std::vector<float>>& dist,
+    void noise(Graph& g, const std::vector<int>& centers, const DistanceMatrix& dist,
                const size_t V);
 };
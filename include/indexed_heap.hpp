@@ -0,0 +1,170 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+// Indexed D-ary heap over payloads addressed by an id in [0, capacity()).
+// Payloads stay in place, indexed by id, and are handed out by reference. The
+// heap itself only moves a compact array of (key, id) slots, keys being
+// extracted with KeyFn on push/update. The top is the greatest key under
+// Compare, so std::less gives a max heap like std::priority_queue.
+template <typename T, typename KeyFn = std::identity, typename Compare = std::less<>, unsigned D = 4>
+class IndexedHeap {
+    static_assert(D >= 2, "IndexedHeap needs at least two children per node");
+
+  public:
+    using Key = std::decay_t<std::invoke_result_t<KeyFn, const T&>>;
+
+    explicit IndexedHeap(size_t capacity = 0, KeyFn key = {}, Compare cmp = {})
+        : key_(std::move(key)), cmp_(std::move(cmp)) {
+        resize(capacity);
+    }
+
+    // Grows the id range, ids already in the heap stay
+    void resize(size_t capacity) {
+        items_.resize(capacity);
+        slot_.resize(capacity, -1);
+    }
+
+    size_t capacity() const { return items_.size(); }
+    size_t size() const { return keys_.size(); }
+    bool empty() const { return keys_.empty(); }
+    bool contains(int id) const { return slot_[id] != -1; }
+
+    void push(int id, const T& item) {
+        if (contains(id))
+            throw std::runtime_error("Id already in heap");
+        items_[id] = item;
+        slot_[id] = static_cast<int>(keys_.size());
+        keys_.push_back(key_(items_[id]));
+        ids_.push_back(id);
+        siftUp(keys_.size() - 1);
+    }
+
+    int topId() const {
+        if (empty())
+            throw std::runtime_error("Heap is empty");
+        return ids_[0];
+    }
+    const T& top() const { return items_[topId()]; }
+    const Key& topKey() const {
+        topId();
+        return keys_[0];
+    }
+
+    // Removes the top, its payload stays readable through operator[]
+    int pop() {
+        int id = topId();
+        slot_[id] = -1;
+        size_t last = keys_.size() - 1;
+        if (last > 0) {
+            keys_[0] = std::move(keys_[last]);
+            ids_[0] = ids_[last];
+            slot_[ids_[0]] = 0;
+        }
+        keys_.pop_back();
+        ids_.pop_back();
+        if (!empty())
+            siftDown(0);
+        return id;
+    }
+
+    const T& operator[](int id) const { return items_[id]; }
+    // Mutable payload. Call update(id) once its key may have changed.
+    T& at(int id) {
+        if (!contains(id))
+            throw std::runtime_error("Id not in heap");
+        return items_[id];
+    }
+
+    // Restores the heap order after the key of id increased or decreased
+    void update(int id) {
+        if (!contains(id))
+            throw std::runtime_error("Id not in heap");
+        size_t i = slot_[id];
+        Key key = key_(items_[id]);
+        bool up = cmp_(keys_[i], key);
+        keys_[i] = std::move(key);
+        if (up)
+            siftUp(i);
+        else
+            siftDown(i);
+    }
+    void update(int id, const T& item) {
+        at(id) = item;
+        update(id);
+    }
+
+    // Pushes id, or updates it when the new item moves it towards the top
+    // (decrease-key for a min heap)
+    bool pushOrImprove(int id, const T& item) {
+        if (!contains(id)) {
+            push(id, item);
+            return true;
+        }
+        if (!cmp_(keys_[slot_[id]], key_(item)))
+            return false;
+        update(id, item);
+        return true;
+    }
+
+    // Drops every entry, O(size())
+    void clear() {
+        for (int id : ids_)
+            slot_[id] = -1;
+        keys_.clear();
+        ids_.clear();
+    }
+
+  private:
+    KeyFn key_;
+    Compare cmp_;
+    std::vector<T> items_;
+    std::vector<int> slot_;
+    // heap order
+    std::vector<Key> keys_;
+    std::vector<int> ids_;
+
+    void place(size_t i, Key&& key, int id) {
+        keys_[i] = std::move(key);
+        ids_[i] = id;
+        slot_[id] = static_cast<int>(i);
+    }
+
+    void siftUp(size_t i) {
+        Key key = std::move(keys_[i]);
+        int id = ids_[i];
+        while (i > 0) {
+            size_t parent = (i - 1) / D;
+            if (!cmp_(keys_[parent], key))
+                break;
+            place(i, std::move(keys_[parent]), ids_[parent]);
+            i = parent;
+        }
+        place(i, std::move(key), id);
+    }
+
+    void siftDown(size_t i) {
+        const size_t n = keys_.size();
+        Key key = std::move(keys_[i]);
+        int id = ids_[i];
+        while (true) {
+            size_t first = D * i + 1;
+            if (first >= n)
+                break;
+            size_t last = std::min(first + D, n);
+            size_t best = first;
+            for (size_t c = first + 1; c < last; ++c)
+                if (cmp_(keys_[best], keys_[c]))
+                    best = c;
+            if (!cmp_(key, keys_[best]))
+                break;
+            place(i, std::move(keys_[best]), ids_[best]);
+            i = best;
+        }
+        place(i, std::move(key), id);
+    }
+};
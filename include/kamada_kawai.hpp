@@ -1,6 +1,8 @@
 #pragma once
 #include "graph.hpp"
 #include "layout.hpp"
+#include "layout_buffers.hpp"
+#include "spring_model.hpp"
 #include <cmath>
 struct KamadaKawaiConf {
     float mx = 800;
@@ -15,20 +17,41 @@ class KamadaKawai : public Layout {
 
   private:
     const KamadaKawaiConf& cfg_;
+    LayoutBuffers buf_;
 
-    std::vector<std::vector<float>> L_;
-    std::vector<std::vector<float>> K_;
+    // graph distances, kept across runs while the topology is unchanged
+    DistanceMatrix dist_;
+    float maxDist_ = 0.0f;
+    uint64_t distVersion_ = 0;
+    SpringModel springs_;
+    // spring lengths and strengths of one row, d_ is decode scratch
+    AlignedVector<float> d_;
+    AlignedVector<float> l_;
+    AlignedVector<float> k_;
+    // column springs, only needed when dist_ is not symmetric
+    AlignedVector<float> lc_;
+    AlignedVector<float> kc_;
+    // energy gradient per node, kept up to date as nodes move
+    AlignedVector<float> gx_;
+    AlignedVector<float> gy_;
+    EnergyHeap heap_;
 
     float fa(float d, float k) { return (d * d) / k; }
     float fr(float d, float k) { return (k * k) / d; }
     float cool(float t) { return t * 0.99f; };
-    void computeLAndK(const std::vector<std::vector<float>>& dist, float L0, float k);
-    void newtonRaphsonNode(Graph& g, int m);
-    std::vector<float> computeEnergyAllNodes(Graph& g);
-    float computeEnergy(Graph& g);
+    void loadSprings(size_t m);
+    // gradient of node m, needs loadSprings(m)
+    void gradient(size_t m, float& gx, float& gy) const;
+    // replaces the contribution of m at (old_x, old_y) in every gradient, needs loadSprings(m)
+    void updateGradients(size_t m, float old_x, float old_y);
+    float computeEnergy();
 
   public:
     ~KamadaKawai() override = default;
     explicit KamadaKawai(const KamadaKawaiConf& cfg) : cfg_(cfg) {}
-    void apply(Graph& g) override;
+    // Newton-Raphson moves of the node with the largest gradient, one per step
+    void init(const Graph& g) override;
+    float step(int n = 1) override;
+    bool converged() const override;
+    void store(Graph& g) const override;
 };
@@ -1,12 +1,80 @@
 #pragma once
 #include "graph.hpp"
+#include "indexed_heap.hpp"
+#include <atomic>
+#include <cstddef>
+#include <exception>
 
 const float EPSILON = 1e-4f;
 
+// Gradient of a node in the stress layouts and its magnitude
+struct NodeEnergy {
+    float energy;
+    float dx = 0.0f;
+    float dy = 0.0f;
+};
+
+struct NodeEnergyKey {
+    float operator()(const NodeEnergy& e) const { return e.energy; }
+};
+// Max-heap of node gradients, the node with the largest energy on top
+using EnergyHeap = IndexedHeap<NodeEnergy, NodeEnergyKey>;
+
+// Where a stepwise layout is, see Layout::state()
+struct LayoutState {
+    // steps taken since init()
+    int iteration = 0;
+    // in [0, 1]
+    float progress = 0.0f;
+    // value returned by the last step()
+    float residual = 0.0f;
+};
+
+// Thrown out of init() and step() once the cancel flag of the layout is set
+struct LayoutCancelled : std::exception {
+    const char* what() const noexcept override { return "layout cancelled"; }
+};
 
+// Layouts run stepwise: init() once, step() until converged(), store() the
+// positions whenever they are needed. Drivers can time-slice, stop early or
+// call init() again for a warm restart, precomputation that only depends on
+// the topology (APSP, hierarchies) is kept while g.topologyVersion matches.
 class Layout {
 
   public:
-    virtual void apply(Graph& g) = 0;
     virtual ~Layout() = default;
+
+    // Starts a run from the positions of g
+    virtual void init(const Graph& g) = 0;
+    // Runs up to n iterations and returns the residual of the last one, an
+    // energy or a displacement depending on the engine. Engines may stop
+    // short of n, e.g. to run the setup of a new phase as a step of its own.
+    virtual float step(int n = 1) = 0;
+    virtual bool converged() const = 0;
+    // Writes the current positions into g
+    virtual void store(Graph& g) const = 0;
+
+    const LayoutState& state() const { return state_; }
+
+    // Set from another thread, the flag aborts long precomputations (APSP,
+    // neighborhoods) with LayoutCancelled. Caches are only kept once complete.
+    void setCancelFlag(const std::atomic<bool>* flag) { cancel_ = flag; }
+
+    // Runs to convergence in one call
+    void apply(Graph& g) {
+        init(g);
+        while (!converged())
+            step(64);
+        store(g);
+    }
+
+  protected:
+    LayoutState state_;
+    const std::atomic<bool>* cancel_ = nullptr;
+
+    bool cancelled() const { return cancel_ && cancel_->load(std::memory_order_relaxed); }
+    void checkCancel() const {
+        if (cancelled())
+            throw LayoutCancelled();
+    }
 };
@@ -0,0 +1,61 @@
+#pragma once
+#include "graph.hpp"
+#include <cstddef>
+#include <new>
+#include <vector>
+
+template <typename T, size_t Align = 64> struct AlignedAllocator {
+    using value_type = T;
+
+    template <typename U> struct rebind {
+        using other = AlignedAllocator<U, Align>;
+    };
+
+    AlignedAllocator() = default;
+    template <typename U> AlignedAllocator(const AlignedAllocator<U, Align>&) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Align))); }
+    void deallocate(T* p, size_t) { ::operator delete(p, std::align_val_t(Align)); }
+
+    template <typename U> bool operator==(const AlignedAllocator<U, Align>&) const { return true; }
+};
+
+template <typename T> using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+// Structure of arrays mirror of node positions and forces. Force kernels
+// work on these buffers, store() syncs positions back to g.nodes.
+struct LayoutBuffers {
+    AlignedVector<float> xs;
+    AlignedVector<float> ys;
+    AlignedVector<float> fxs;
+    AlignedVector<float> fys;
+
+    size_t size() const { return xs.size(); }
+
+    void load(const Graph& g) {
+        const size_t V = g.nodes.size();
+        xs.resize(V);
+        ys.resize(V);
+        fxs.assign(V, 0.0f);
+        fys.assign(V, 0.0f);
+        for (size_t i = 0; i < V; ++i) {
+            xs[i] = g.nodes[i].x;
+            ys[i] = g.nodes[i].y;
+        }
+    }
+
+    void store(Graph& g) const {
+        for (size_t i = 0; i < xs.size(); ++i) {
+            g.nodes[i].x = xs[i];
+            g.nodes[i].y = ys[i];
+            g.nodes[i].dx = fxs[i];
+            g.nodes[i].dy = fys[i];
+        }
+        g.positionVersion = Graph::nextVersion();
+    }
+
+    void resetForces() {
+        std::fill(fxs.begin(), fxs.end(), 0.0f);
+        std::fill(fys.begin(), fys.end(), 0.0f);
+    }
+};
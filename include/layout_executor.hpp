@@ -0,0 +1,115 @@
+#pragma once
+#include "graph.hpp"
+#include "layout.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs one layout at a time on a worker thread, on a private copy of the
+// graph. The worker calls step() in batches of a few milliseconds and, at
+// most once per consumed snapshot and interval, stores the positions into a
+// snapshot the render thread picks up with collect(). Snapshots move between
+// the two sides by swapping buffers, so the only lock is held for a swap.
+class LayoutExecutor {
+
+  public:
+    enum class State { Idle, Running, Paused, Cancelling, Finished, Cancelled, Failed };
+
+    LayoutExecutor() = default;
+    LayoutExecutor(const LayoutExecutor&) = delete;
+    LayoutExecutor& operator=(const LayoutExecutor&) = delete;
+    ~LayoutExecutor();
+
+    // Starts L on a copy of g. The executor keeps its own copy of cfg, so
+    // the caller may edit theirs while the layout runs. The engine of the
+    // previous run is reused when it has the same type, which keeps its
+    // topology caches (APSP, hierarchies).
+    template <typename L, typename Conf> void start(const Conf& cfg, const Graph& g) {
+        stop();
+        // an engine that threw may be left half initialized
+        if (state() == State::Failed)
+            job_.reset();
+        if (auto* job = dynamic_cast<Job<L, Conf>*>(job_.get()))
+            job->cfg = cfg;
+        else
+            job_ = std::make_unique<Job<L, Conf>>(cfg);
+        launch(g);
+    }
+
+    void pause();
+    void resume();
+    // Asks the run to stop and returns at once, the state stays Cancelling
+    // until the worker is done. Without keepPositions the positions it has
+    // not handed out yet are dropped.
+    void cancel(bool keepPositions = true);
+    // Joins the worker once the run is Finished, Cancelled or Failed, call
+    // it every frame from the thread that started the run
+    void poll();
+
+    State state() const { return state_.load(std::memory_order_acquire); }
+    bool busy() const;
+    float progress() const { return progress_.load(std::memory_order_relaxed); }
+    // What the engine threw, valid once the state is Failed
+    const std::string& error() const { return error_; }
+
+    // Copies the newest snapshot into g, if there is one. Call it from the
+    // thread that owns g, returns true when positions changed.
+    bool collect(Graph& g);
+
+    // Minimum time between two snapshots
+    std::chrono::milliseconds interval{15};
+    // Time the worker aims to spend in one step() batch. Pause and cancel
+    // act between batches, so ordinary steps answer within about a slice.
+    // init() and phase setups that run as a single step (HK levels) can take
+    // longer: cancel interrupts them, pause waits for them to end.
+    std::chrono::microseconds slice{4000};
+
+  private:
+    struct JobBase {
+        virtual ~JobBase() = default;
+        virtual Layout& layout() = 0;
+    };
+    template <typename L, typename Conf> struct Job : JobBase {
+        Conf cfg;
+        L engine;
+        explicit Job(const Conf& c) : cfg(c), engine(cfg) {}
+        Layout& layout() override { return engine; }
+    };
+
+    std::unique_ptr<JobBase> job_;
+    Graph work_;
+    std::thread worker_;
+
+    std::atomic<State> state_{State::Idle};
+    std::atomic<float> progress_{0.0f};
+    std::atomic<bool> cancel_{false};
+    std::atomic<bool> paused_{false};
+    // written by the worker before it publishes Failed
+    std::string error_;
+    std::mutex pauseMutex_;
+    std::condition_variable pauseCv_;
+
+    // snapshots as interleaved x, y. back_ is written by the worker, front_
+    // read by collect(), ready_ is handed over under swapMutex_
+    std::vector<float> back_;
+    std::vector<float> ready_;
+    std::vector<float> front_;
+    std::mutex swapMutex_;
+    std::atomic<bool> fresh_{false};
+    // set by cancel(false), the worker publishes nothing more
+    bool discard_ = false;
+    std::chrono::steady_clock::time_point lastPublish_;
+
+    void launch(const Graph& g);
+    void run();
+    void stop();
+    bool wantsPositions();
+    void publish();
+    // Blocks while paused, false once cancelled
+    bool proceed();
+};
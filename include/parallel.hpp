@@ -0,0 +1,47 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+inline unsigned workerCount() { return std::max(1u, std::thread::hardware_concurrency()); }
+
+// Calls f(i, worker) for every i in [0, n). Indices are handed out in
+// chunks from a shared counter, the calling thread is worker 0.
+template <typename F> void parallelFor(size_t n, F&& f, size_t chunk = 1) {
+    const unsigned workers = std::min<size_t>(workerCount(), (n + chunk - 1) / std::max<size_t>(chunk, 1));
+    std::atomic<size_t> next{0};
+    auto run = [&](unsigned worker) {
+        while (true) {
+            size_t begin = next.fetch_add(chunk, std::memory_order_relaxed);
+            if (begin >= n)
+                break;
+            size_t end = std::min(begin + chunk, n);
+            for (size_t i = begin; i < end; ++i)
+                f(i, worker);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned w = 1; w < workers; ++w)
+        threads.emplace_back(run, w);
+    run(0);
+    for (auto& t : threads)
+        t.join();
+}
+
+// Splits [0, n) into one contiguous range per worker and calls
+// f(begin, end, worker). Returns the number of workers used.
+template <typename F> unsigned parallelRanges(size_t n, F&& f) {
+    const unsigned workers = std::max<size_t>(std::min<size_t>(workerCount(), n), 1);
+    const size_t step = (n + workers - 1) / workers;
+
+    std::vector<std::thread> threads;
+    for (unsigned w = 1; w < workers; ++w)
+        threads.emplace_back([&, w] { f(std::min(w * step, n), std::min((w + 1) * step, n), w); });
+    f(0, std::min(step, n), 0u);
+    for (auto& t : threads)
+        t.join();
+    return workers;
+}
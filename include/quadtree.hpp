@@ -0,0 +1,70 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <vector>
+
+struct QuadCell {
+    float x0 = 0, y0 = 0; // lower-left corner
+    float size = 0;
+    float cx = 0, cy = 0; // center of mass
+    float mass = 0;
+    int child = -1; // first of 4 consecutive children, -1 for leaves
+    int begin = 0, end = 0;
+};
+
+// Flat Barnes-Hut quadtree. Cells live in one pool that is reused between builds.
+class QuadTree {
+
+  public:
+    static constexpr int MAX_DEPTH = 32;
+
+    explicit QuadTree(int leafSize = 8) : leafSize_(leafSize) {}
+
+    void build(const float* xs, const float* ys, size_t n);
+    const std::vector<QuadCell>& cells() const { return cells_; }
+    bool empty() const { return cells_.empty(); }
+
+    // Calls f(x, y, mass) for every body or aggregated cell seen from (x, y)
+    // under the opening criterion size / dist < theta.
+    template <typename F> void forEachInteraction(float x, float y, float theta, F&& f) const {
+        if (cells_.empty())
+            return;
+        const float theta2 = theta * theta;
+        std::array<int, 4 * MAX_DEPTH + 4> stack;
+        int top = 0;
+        stack[top++] = 0;
+
+        while (top > 0) {
+            const QuadCell& c = cells_[stack[--top]];
+            if (c.mass == 0.0f)
+                continue;
+
+            if (c.child == -1) {
+                for (int i = c.begin; i < c.end; ++i)
+                    f(xs_[i], ys_[i], 1.0f);
+                continue;
+            }
+
+            bool inside = x >= c.x0 && x < c.x0 + c.size && y >= c.y0 && y < c.y0 + c.size;
+            float dx = x - c.cx;
+            float dy = y - c.cy;
+            float dist2 = dx * dx + dy * dy;
+            if (!inside && c.size * c.size < theta2 * dist2) {
+                f(c.cx, c.cy, c.mass);
+                continue;
+            }
+            for (int k = 0; k < 4; ++k)
+                stack[top++] = c.child + k;
+        }
+    }
+
+  private:
+    int leafSize_;
+    std::vector<QuadCell> cells_;
+    std::vector<int> order_;
+    // body positions in tree order
+    std::vector<float> xs_;
+    std::vector<float> ys_;
+
+    void buildCell(const float* xs, const float* ys, int cell, int depth);
+};
@@ -1,22 +1,88 @@
 #pragma once
 #include "camera.hpp"
 #include "graph.hpp"
+#include "graph_csr.hpp"
+#include "view_index.hpp"
+#include <chrono>
+#include <cstdint>
+#include <vector>
 
+// OpenGL 3.3 core renderer. Node positions live in one vertex buffer that
+// is rewritten only when graph positionVersion changes. A ViewIndex over
+// the same positions picks the nodes and edges overlapping the view, only
+// those are streamed and drawn: edges as indices into the position buffer,
+// nodes as instanced quads. While a layout streams positions the index is
+// rebuilt a few times a second only, culling meanwhile uses slightly older
+// positions. Zoomed out until nodes are a few pixels apart,
+// large graphs are drawn as one glyph per cluster of nodes instead, sized
+// by node count, and the heaviest edges between clusters.
 class Render {
   public:
+    // Needs a current context with the GL functions loaded
     explicit Render(Graph* g);
+    ~Render();
+    Render(const Render&) = delete;
+    Render& operator=(const Render&) = delete;
 
     void setWindowSize(float w, float h);
     void renderGraph(const Camera2D& camera, float nodeSize);
 
   private:
-    void applyCameraTransform(const Camera2D& camera);
+    void syncBuffers();
+    void cull(const Camera2D& camera, float nodeSize);
+    int clusterLevel(float zoom) const;
     void renderEdges();
     void renderNodes(float nodeSize, const Camera2D& cam);
-    void renderAxes(float extent);
+    void renderAxes();
 
   private:
+    struct CullKey {
+        float x, y, zoom, w, h, nodeSize;
+        uint64_t positionVersion, topologyVersion, indexVersion;
+        bool operator==(const CullKey&) const = default;
+    };
+
     Graph* graph_;
+    GraphCSR csr_;
+    ViewIndex index_;
     float w_ = 1.0f;
     float h_ = 1.0f;
+
+    // Uploaded state, compared against the graph every frame
+    uint64_t topologyVersion_ = UINT64_MAX;
+    uint64_t positionVersion_ = UINT64_MAX;
+    size_t positionCapacity_ = 0;
+    size_t nodeCount_ = 0;
+    std::vector<float> xy_;
+    // positions and topology the index was built from
+    uint64_t indexVersion_ = UINT64_MAX;
+    uint64_t indexTopology_ = UINT64_MAX;
+    size_t indexNodeCount_ = 0;
+    std::chrono::steady_clock::time_point indexBuilt_;
+
+    // Result of the last cull, redrawn as is while the key matches
+    CullKey cullKey_{};
+    bool culled_ = false;
+    int level_ = 0;
+    size_t edgeIndexCount_ = 0;
+    size_t instanceCount_ = 0;
+    size_t lineVertexCount_ = 0;
+    std::vector<uint32_t> visibleNodes_;
+    std::vector<uint32_t> visibleEdges_;
+    std::vector<float> stream_;
+    std::vector<float> lines_;
+
+    unsigned lineProgram_ = 0;
+    unsigned pointProgram_ = 0;
+    unsigned positions_ = 0;
+    unsigned indices_ = 0;
+    unsigned instances_ = 0;
+    unsigned clusterLines_ = 0;
+    unsigned quad_ = 0;
+    unsigned axes_ = 0;
+    unsigned edgeVao_ = 0;
+    unsigned nodeVao_ = 0;
+    unsigned clusterVao_ = 0;
+    unsigned clusterLineVao_ = 0;
+    unsigned axesVao_ = 0;
 };
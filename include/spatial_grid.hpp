@@ -0,0 +1,88 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+// Uniform grid over node positions, rebuilt with a counting sort.
+class SpatialGrid {
+
+  public:
+    // Cell size is enlarged when the bounding box would need more than
+    // maxCellsPerNode * V cells.
+    void build(const float* xs, const float* ys, size_t n, float cellSize, float maxCellsPerNode = 4.0f);
+
+    float cellSize() const { return cellSize_; }
+    int cols() const { return cols_; }
+    int rows() const { return rows_; }
+    float originX() const { return x0_; }
+    float originY() const { return y0_; }
+
+    // Row-major cell index of node i, nodes of cell c in index order
+    int cellOf(size_t i) const { return cellOf_[i]; }
+    std::span<const int> cell(int c) const {
+        return {items_.data() + cellStart_[c], items_.data() + cellStart_[c + 1]};
+    }
+
+    int cellX(float x) const { return std::clamp(static_cast<int>((x - x0_) / cellSize_), 0, cols_ - 1); }
+    int cellY(float y) const { return std::clamp(static_cast<int>((y - y0_) / cellSize_), 0, rows_ - 1); }
+
+    // Calls f(j) for every node stored in the 3x3 cells around (x, y)
+    template <typename F> void forEachNeighbor(float x, float y, F&& f) const {
+        if (items_.empty())
+            return;
+        const int cx = cellX(x);
+        const int cy = cellY(y);
+        for (int gy = std::max(cy - 1, 0); gy <= std::min(cy + 1, rows_ - 1); ++gy) {
+            const int row = gy * cols_;
+            const int begin = cellStart_[row + std::max(cx - 1, 0)];
+            const int end = cellStart_[row + std::min(cx + 1, cols_ - 1) + 1];
+            for (int k = begin; k < end; ++k)
+                f(items_[k]);
+        }
+    }
+
+  private:
+    float x0_ = 0, y0_ = 0;
+    float cellSize_ = 1;
+    int cols_ = 0, rows_ = 0;
+    std::vector<int> cellStart_;
+    std::vector<int> items_;
+    std::vector<int> cellOf_;
+    std::vector<int> fill_;
+};
+
+// Uniform grid with per-cell linked lists, so nodes can be moved between
+// cells in O(1) while the layout updates positions in place.
+class CellList {
+
+  public:
+    void build(const float* xs, const float* ys, size_t n, float cellSize, float maxCellsPerNode = 4.0f);
+    void move(int i, float x, float y);
+
+    // Calls f(j) for every node stored in the 3x3 cells around (x, y)
+    template <typename F> void forEachNeighbor(float x, float y, F&& f) const {
+        if (head_.empty())
+            return;
+        const int cx = cellX(x);
+        const int cy = cellY(y);
+        for (int gy = std::max(cy - 1, 0); gy <= std::min(cy + 1, rows_ - 1); ++gy)
+            for (int gx = std::max(cx - 1, 0); gx <= std::min(cx + 1, cols_ - 1); ++gx)
+                for (int j = head_[gy * cols_ + gx]; j != -1; j = next_[j])
+                    f(j);
+    }
+
+  private:
+    float x0_ = 0, y0_ = 0;
+    float cellSize_ = 1;
+    int cols_ = 0, rows_ = 0;
+    std::vector<int> head_;
+    std::vector<int> next_;
+    std::vector<int> prev_;
+    std::vector<int> cell_;
+
+    int cellX(float x) const { return std::clamp(static_cast<int>((x - x0_) / cellSize_), 0, cols_ - 1); }
+    int cellY(float y) const { return std::clamp(static_cast<int>((y - y0_) / cellSize_), 0, rows_ - 1); }
+    void link(int i, int c);
+    void unlink(int i);
+};
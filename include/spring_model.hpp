@@ -0,0 +1,62 @@
+#pragma once
+#include "distance_matrix.hpp"
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// Stress springs derived from graph distances on demand instead of V x V
+// length/strength matrices: l = scale * d and k = K / d^2. Unreachable pairs
+// get l = L0, k = 0, and d = 0 gets no spring. For hop count matrices the
+// strengths come from a table indexed by hop count.
+class SpringModel {
+
+  public:
+    SpringModel() = default;
+    // maxDist is dist.maxFinite(), it bounds the hop count table
+    SpringModel(const DistanceMatrix& dist, float maxDist, float L0, float K, float lengthScale)
+        : L0_(L0), K_(K), scale_(lengthScale), invUnit_(1.0f / dist.unit()) {
+        if (dist.storage() == DistanceMatrix::Storage::Float)
+            return;
+        strengthByHop_.resize(static_cast<size_t>(std::lround(maxDist * invUnit_)) + 1);
+        strengthByHop_[0] = 0.0f;
+        for (size_t h = 1; h < strengthByHop_.size(); ++h) {
+            float d = h * dist.unit();
+            strengthByHop_[h] = K / (d * d);
+        }
+    }
+
+    float length(float d) const { return std::isfinite(d) ? scale_ * d : L0_; }
+    float strength(float d) const {
+        if (!std::isfinite(d))
+            return 0.0f;
+        if (!strengthByHop_.empty())
+            return strengthByHop_[static_cast<size_t>(d * invUnit_ + 0.5f)];
+        return d > 0.0f ? K_ / (d * d) : 0.0f;
+    }
+
+    // Fills l[j] and k[j] for the springs of row i, d is scratch of dist.size()
+    void row(const DistanceMatrix& dist, size_t i, float* d, float* l, float* k) const {
+        dist.row(i, d);
+        for (size_t j = 0; j < dist.size(); ++j) {
+            l[j] = length(d[j]);
+            k[j] = strength(d[j]);
+        }
+    }
+
+    // Same for the springs of column j
+    void column(const DistanceMatrix& dist, size_t j, float* l, float* k) const {
+        for (size_t i = 0; i < dist.size(); ++i) {
+            float d = dist(i, j);
+            l[i] = length(d);
+            k[i] = strength(d);
+        }
+    }
+
+  private:
+    float L0_ = 0.0f;
+    float K_ = 0.0f;
+    float scale_ = 0.0f;
+    float invUnit_ = 1.0f;
+    // K / (h * unit)^2 per hop count h, empty for float distances
+    std::vector<float> strengthByHop_;
+};
@@ -6,9 +6,11 @@
 #include "harell_koren.hpp"
 #include "imgui.h"
 #include "kamada_kawai.hpp"
+#include "layout_executor.hpp"
 #include "walshaw.hpp"
 #include <filesystem>
 #include <imgui_stdlib.h>
+#include <iostream>
 #include <memory>
 #include <string>
 #include <vector>
@@ -21,12 +23,14 @@ class UIManager {
     // Layout
     int currentLayout = 0;
     const char* layoutItems[5] = {"Fruchterman", "Harel-Koren", "Walshaw", "Kamda-Kawai", "Eades"};
+    const char* repulsionModes[3] = {"Exact", "Barnes-Hut", "Grid"};
     FruchtermanReingoldConf fruchtermanConfig;
     HarellKorenConf harelConfig;
     WalshawConf walshawConfig;
     KamadaKawaiConf kamadaKawaiConfig;
     EadesConf eadesConfig;
     bool initialized = false;
+    LayoutExecutor executor;
 
     // Loader
     const char* graphSources[4] = {
@@ -46,6 +50,8 @@ class UIManager {
     int sierpinksiDepth = 2;
 
     void render(Graph& graph, float W, float H) {
+        executor.poll();
+        executor.collect(graph);
         ImGui::Begin("Graph Controls");
 
         if (ImGui::BeginTabBar("GraphTabs")) {
@@ -95,7 +101,8 @@ class UIManager {
         }
         std::vector<std::string> files;
         for (const auto& file : std::filesystem::directory_iterator(path)) {
-            if (file.is_regular_file()) {
+            // binary caches are picked up through their source file
+            if (file.is_regular_file() && file.path().extension() != ".glc") {
                 files.push_back(file.path().filename().string());
             }
         }
@@ -143,10 +150,15 @@ class UIManager {
             break;
         }
         if (ImGui::Button("Load Graph")) {
+            executor.cancel(false);
             graph.clear();
             switch (currentGraphSource) {
             case 0:
-                loadGraphPath(graph, selectedFilePath);
+                try {
+                    loadGraphPath(graph, selectedFilePath);
+                } catch (const std::exception& e) {
+                    std::clog << "could not load " << selectedFilePath << ": " << e.what() << "\n";
+                }
                 break;
             case 1:
                 buildGrid(graph, gridWidth, gridHeight);
@@ -198,9 +210,29 @@ class UIManager {
             break;
         }
 
-        if (ImGui::Button("Apply Layout")) {
-            applyCurrentLayout(graph);
+        if (!executor.busy()) {
+            if (executor.state() == LayoutExecutor::State::Failed)
+                ImGui::TextWrapped("Layout failed: %s", executor.error().c_str());
+            if (ImGui::Button("Apply Layout"))
+                applyCurrentLayout(graph);
+            return;
+        }
+
+        ImGui::ProgressBar(executor.progress());
+        if (executor.state() == LayoutExecutor::State::Cancelling) {
+            ImGui::Text("Cancelling...");
+            return;
+        }
+        bool paused = executor.state() == LayoutExecutor::State::Paused;
+        if (ImGui::Button(paused ? "Resume" : "Pause")) {
+            if (paused)
+                executor.resume();
+            else
+                executor.pause();
         }
+        ImGui::SameLine();
+        if (ImGui::Button("Cancel"))
+            executor.cancel();
     }
 
     void renderFruchterman() {
@@ -209,6 +241,11 @@ class UIManager {
         ImGui::InputFloat("Height", &fruchtermanConfig.my);
         ImGui::InputFloat("C", &fruchtermanConfig.C);
         ImGui::InputInt("Iterations", &fruchtermanConfig.max_iter);
+        int mode = static_cast<int>(fruchtermanConfig.mode);
+        if (ImGui::Combo("Repulsion", &mode, repulsionModes, IM_ARRAYSIZE(repulsionModes)))
+            fruchtermanConfig.mode = static_cast<RepulsionMode>(mode);
+        if (fruchtermanConfig.mode == RepulsionMode::BarnesHut)
+            ImGui::SliderFloat("Theta", &fruchtermanConfig.theta, 0.0f, 1.5f);
     }
 
     void renderHarelKoren() {
@@ -250,29 +287,27 @@ class UIManager {
         ImGui::InputFloat("C2", &eadesConfig.c2);
         ImGui::InputFloat("C3", &eadesConfig.c3);
         ImGui::InputFloat("C4", &eadesConfig.c4);
+        ImGui::Checkbox("SIMD", &eadesConfig.simd);
     }
 
-    // TODO: Threads
-    void applyCurrentLayout(Graph& graph) {
-        std::unique_ptr<Layout> layout;
+    // Runs on the executor's worker, positions stream back through collect()
+    void applyCurrentLayout(const Graph& graph) {
         switch (currentLayout) {
         case 0:
-            layout = std::make_unique<FruchtermanReingold>(fruchtermanConfig);
+            executor.start<FruchtermanReingold>(fruchtermanConfig, graph);
             break;
         case 1:
-            layout = std::make_unique<HarellKoren>(harelConfig);
+            executor.start<HarellKoren>(harelConfig, graph);
             break;
         case 2:
-            layout = std::make_unique<Walshaw>(walshawConfig);
+            executor.start<Walshaw>(walshawConfig, graph);
             break;
         case 3:
-            layout = std::make_unique<KamadaKawai>(kamadaKawaiConfig);
+            executor.start<KamadaKawai>(kamadaKawaiConfig, graph);
             break;
         case 4:
-            layout = std::make_unique<Eades>(eadesConfig);
+            executor.start<Eades>(eadesConfig, graph);
             break;
         }
-        if (layout)
-            layout->apply(graph);
     }
 };
@@ -0,0 +1,85 @@
+#pragma once
+#include "graph.hpp"
+#include "graph_csr.hpp"
+#include "spatial_grid.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Axis-aligned world rectangle, inverted (x0 > x1) while empty
+struct ViewRect {
+    float x0 = std::numeric_limits<float>::max();
+    float y0 = std::numeric_limits<float>::max();
+    float x1 = std::numeric_limits<float>::lowest();
+    float y1 = std::numeric_limits<float>::lowest();
+
+    bool intersects(const ViewRect& o) const { return x0 <= o.x1 && o.x0 <= x1 && y0 <= o.y1 && o.y0 <= y1; }
+    bool contains(float x, float y) const { return x0 <= x && x <= x1 && y0 <= y && y <= y1; }
+    void add(float x, float y) {
+        x0 = std::min(x0, x);
+        y0 = std::min(y0, y);
+        x1 = std::max(x1, x);
+        y1 = std::max(y1, y);
+    }
+    void add(const ViewRect& o) {
+        x0 = std::min(x0, o.x0);
+        y0 = std::min(y0, o.y0);
+        x1 = std::max(x1, o.x1);
+        y1 = std::max(y1, o.y1);
+    }
+};
+
+// Culling and level-of-detail queries over a drawing of a graph. Nodes are
+// binned in a SpatialGrid of about one node per cell, canonical edges go to
+// the cell of their first node. Levels above merge 2x2 cells, keeping the
+// bounds of everything below, node counts and centroids, so queries only
+// descend into cells that overlap the view. Rebuild when positions change.
+class ViewIndex {
+
+  public:
+    void build(const Graph& g, const GraphCSR& csr);
+
+    int levelCount() const { return static_cast<int>(levels_.size()); }
+    // Cell width of a level in world units, level 0 is the finest
+    float cellSize(int level) const { return grid_.cellSize() * static_cast<float>(1 << level); }
+
+    // Nodes inside view, and canonical edges whose bounds overlap it as
+    // (src, dst) pairs
+    void query(const ViewRect& view, std::vector<uint32_t>& nodes, std::vector<uint32_t>& edges) const;
+
+    // Non-empty cells of level overlapping view as (x, y, count) at their
+    // centroid, and up to maxEdges of the edges between cells of that level
+    // with the most edges as (x0, y0, x1, y1) lines
+    void queryClusters(const ViewRect& view, int level, size_t maxEdges, std::vector<float>& glyphs,
+                       std::vector<float>& lines);
+
+  private:
+    struct Cell {
+        ViewRect bounds;
+        uint32_t count = 0;
+        double sumX = 0, sumY = 0;
+    };
+    struct Level {
+        int cols, rows;
+        std::vector<Cell> cells;
+    };
+    struct ClusterEdge {
+        int a, b;
+        uint32_t count;
+    };
+
+    SpatialGrid grid_;
+    std::vector<float> xs_, ys_;
+    // Edges of level 0 cell c are edgePairs_[2 * edgeStart_[c] ..]
+    std::vector<uint32_t> edgeStart_;
+    std::vector<uint32_t> edgePairs_;
+    std::vector<Level> levels_;
+    // Per level, built on first use, heaviest first
+    std::vector<std::vector<ClusterEdge>> clusterEdges_;
+    std::vector<bool> clusterEdgesBuilt_;
+
+    // Calls f(c) for every cell of level overlapping view
+    template <typename F> void forEachCell(const ViewRect& view, int level, F&& f) const;
+    void buildClusterEdges(int level);
+};
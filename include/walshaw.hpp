@@ -1,6 +1,9 @@
 #pragma once
 #include "graph.hpp"
+#include "graph_csr.hpp"
 #include "layout.hpp"
+#include "layout_buffers.hpp"
+#include "spatial_grid.hpp"
 #include <cmath>
 
 struct WalshawConf {
@@ -9,13 +12,38 @@ struct WalshawConf {
     int max_iter = 100;
     float C = 1;
     float tol = 0.01f;
+    // Stop coarsening once a level has at most this many nodes
+    int min_size = 2;
 };
+
 class Walshaw : public Layout {
 
   private:
-    WalshawConf cfg_;
+    const WalshawConf& cfg_;
     float R_;
 
+    // levels_[0] is the first coarsened graph, parents_[l] maps nodes of
+    // level l (0 = input graph) to level l + 1. Kept across runs while the
+    // topology of the input is unchanged.
+    Graph fine_;
+    std::vector<float> fineWeights_;
+    std::vector<Graph> levels_;
+    std::vector<std::vector<float>> weights_;
+    std::vector<std::vector<int>> parents_;
+    uint64_t hierarchyVersion_ = 0;
+    int hierarchyMinSize_ = 0;
+
+    // level being laid out (0 = input graph) and its sweep state
+    size_t level_ = 0;
+    float levelK_ = 0.0f;
+    float T_ = 0.0f;
+    int levelIter_ = 0;
+    bool done_ = true;
+
+    GraphCSR csr_;
+    LayoutBuffers buf_;
+    CellList cells_;
+
     constexpr float fg(const float x, const float w, const float k) {
         if (x <= R_)
             return -cfg_.C * w * k * k / x;
@@ -34,8 +62,23 @@ class Walshaw : public Layout {
 
     constexpr float cool(const float t) { return t * 0.99f; }
 
+    bool coarsen(const Graph& g, const std::vector<float>& w, Graph& coarse, std::vector<float>& coarseW,
+                 std::vector<int>& parent);
+    void buildHierarchy(const Graph& g);
+    // Places every coarse node at the weighted centroid of its children
+    void placeCoarseNodes();
+    Graph& levelGraph(size_t l) { return l == 0 ? fine_ : levels_[l - 1]; }
+    const std::vector<float>& levelWeights(size_t l) const { return l == 0 ? fineWeights_ : weights_[l - 1]; }
+    void beginLevel(size_t l, float K);
+    // One sweep over the nodes of the current level, returns the largest move
+    float sweep();
+
   public:
     explicit Walshaw(const WalshawConf& cfg) : cfg_(cfg) {}
     ~Walshaw() override = default;
-    void apply(Graph& g) override;
+    // One sweep of the current level per step, coarsest level first
+    void init(const Graph& g) override;
+    float step(int n = 1) override;
+    bool converged() const override;
+    void store(Graph& g) const override;
 };
@@ -0,0 +1,269 @@
+#include "eades.hpp"
+#include "fruchterman_reingold.hpp"
+#include "graph.hpp"
+#include "graph_cache.hpp"
+#include "graph_loader.hpp"
+#include "harell_koren.hpp"
+#include "kamada_kawai.hpp"
+#include "walshaw.hpp"
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Headless driver: load or generate a graph, run one layout, write the
+// positions. No windowing or GL, so it runs on machines without a display.
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Setter = std::function<void(const std::string&)>;
+
+double seconds(Clock::time_point since) { return std::chrono::duration<double>(Clock::now() - since).count(); }
+
+void usage() {
+    std::cerr << "usage: graph-layout-cli [input] [options]\n"
+                 "input, one of:\n"
+                 "  -i FILE             .mtx, .src (also .gz, .zst) or .glc graph\n"
+                 "  --grid WxH          grid graph\n"
+                 "  --torus NxM         torus graph\n"
+                 "  --sierpinski D      Sierpinski triangle of depth D\n"
+                 "options:\n"
+                 "  -l LAYOUT           fr (default), hk, walshaw, kk, eades\n"
+                 "  -o FILE             write 'id x y' per node\n"
+                 "  --save-glc FILE     write graph and positions as a binary .glc file\n"
+                 "  --warm              start from the positions stored in a .glc input\n"
+                 "  --no-cache          neither read nor write <input>.glc\n"
+                 "  -p KEY=VALUE        layout parameter, repeatable (-p help lists them)\n"
+                 "  --width W           layout area, default 800\n"
+                 "  --height H          layout area, default 600\n"
+                 "  --seed S            seed of the initial positions\n";
+}
+
+std::pair<int, int> parseDims(const std::string& s) {
+    size_t x = s.find('x');
+    if (x == std::string::npos)
+        return {std::stoi(s), std::stoi(s)};
+    return {std::stoi(s.substr(0, x)), std::stoi(s.substr(x + 1))};
+}
+
+// Owns the config of the chosen layout and maps -p keys onto its fields
+struct LayoutChoice {
+    std::shared_ptr<void> cfg;
+    std::unique_ptr<Layout> layout;
+    std::map<std::string, Setter> params;
+    std::function<void(float, float)> area;
+};
+
+Setter setFloat(float& f) {
+    return [&f](const std::string& v) { f = std::stof(v); };
+}
+Setter setInt(int& i) {
+    return [&i](const std::string& v) { i = std::stoi(v); };
+}
+
+template <typename L, typename Conf> LayoutChoice makeChoice(std::map<std::string, Setter> (*keys)(Conf&)) {
+    auto cfg = std::make_shared<Conf>();
+    LayoutChoice c;
+    c.cfg = cfg;
+    c.layout = std::make_unique<L>(*cfg);
+    c.params = keys(*cfg);
+    c.area = [cfg = cfg.get()](float w, float h) {
+        cfg->mx = w;
+        cfg->my = h;
+    };
+    return c;
+}
+
+LayoutChoice chooseLayout(const std::string& name) {
+    if (name == "fr")
+        return makeChoice<FruchtermanReingold, FruchtermanReingoldConf>(+[](FruchtermanReingoldConf& c) {
+            return std::map<std::string, Setter>{
+                {"iters", setInt(c.max_iter)},
+                {"C", setFloat(c.C)},
+                {"theta", setFloat(c.theta)},
+                {"mode", [&c](const std::string& v) {
+                     if (v == "exact")
+                         c.mode = RepulsionMode::Exact;
+                     else if (v == "bh")
+                         c.mode = RepulsionMode::BarnesHut;
+                     else if (v == "grid")
+                         c.mode = RepulsionMode::Grid;
+                     else
+                         throw std::runtime_error("mode is exact, bh or grid");
+                 }},
+            };
+        });
+    if (name == "hk")
+        return makeChoice<HarellKoren, HarellKorenConf>(+[](HarellKorenConf& c) {
+            return std::map<std::string, Setter>{
+                {"iters", setInt(c.max_iter)}, {"rad", setInt(c.rad)},  {"ratio", setInt(c.ratio)},
+                {"min_size", setInt(c.min_size)}, {"K", setFloat(c.K)},
+            };
+        });
+    if (name == "walshaw")
+        return makeChoice<Walshaw, WalshawConf>(+[](WalshawConf& c) {
+            return std::map<std::string, Setter>{
+                {"iters", setInt(c.max_iter)},
+                {"C", setFloat(c.C)},
+                {"tol", setFloat(c.tol)},
+                {"min_size", setInt(c.min_size)},
+            };
+        });
+    if (name == "kk")
+        return makeChoice<KamadaKawai, KamadaKawaiConf>(+[](KamadaKawaiConf& c) {
+            return std::map<std::string, Setter>{
+                {"iters", setInt(c.max_iter)},
+                {"iters2", setInt(c.max_iter_2)},
+                {"K", setFloat(c.K)},
+                {"multL", setFloat(c.multL)},
+            };
+        });
+    if (name == "eades")
+        return makeChoice<Eades, EadesConf>(+[](EadesConf& c) {
+            return std::map<std::string, Setter>{
+                {"iters", setInt(c.max_iter)}, {"c1", setFloat(c.c1)}, {"c2", setFloat(c.c2)},
+                {"c3", setFloat(c.c3)},        {"c4", setFloat(c.c4)},
+                {"simd", [&c](const std::string& v) { c.simd = v != "0" && v != "false"; }},
+            };
+        });
+    throw std::runtime_error("unknown layout " + name);
+}
+
+void writePositions(const Graph& g, const std::string& path) {
+    std::ofstream out(path);
+    if (!out.is_open())
+        throw std::runtime_error("failed to open " + path);
+    for (const Node& n : g.nodes)
+        out << n.id << ' ' << n.x << ' ' << n.y << '\n';
+}
+
+int run(int argc, char** argv) {
+    std::string input, output, layoutName = "fr";
+    std::string generator, genArg;
+    std::vector<std::string> params;
+    float width = 800.0f, height = 600.0f;
+    unsigned seed = 1;
+    std::string saveGlc;
+    bool warm = false;
+    bool cache = true;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc)
+                throw std::runtime_error(arg + " needs a value");
+            return argv[++i];
+        };
+        if (arg == "-h" || arg == "--help") {
+            usage();
+            return 0;
+        } else if (arg == "-i") {
+            input = next();
+        } else if (arg == "--grid" || arg == "--torus" || arg == "--sierpinski") {
+            generator = arg.substr(2);
+            genArg = next();
+        } else if (arg == "-l") {
+            layoutName = next();
+        } else if (arg == "-o") {
+            output = next();
+        } else if (arg == "--save-glc") {
+            saveGlc = next();
+        } else if (arg == "--warm") {
+            warm = true;
+        } else if (arg == "--no-cache") {
+            cache = false;
+        } else if (arg == "-p") {
+            params.push_back(next());
+        } else if (arg == "--width") {
+            width = std::stof(next());
+        } else if (arg == "--height") {
+            height = std::stof(next());
+        } else if (arg == "--seed") {
+            seed = std::stoul(next());
+        } else {
+            throw std::runtime_error("unknown argument " + arg);
+        }
+    }
+
+    LayoutChoice choice = chooseLayout(layoutName);
+    choice.area(width, height);
+    for (const std::string& p : params) {
+        if (p == "help") {
+            std::cout << layoutName << " parameters:";
+            for (const auto& [key, set] : choice.params)
+                std::cout << ' ' << key;
+            std::cout << '\n';
+            return 0;
+        }
+        size_t eq = p.find('=');
+        auto it = choice.params.find(p.substr(0, eq));
+        if (eq == std::string::npos || it == choice.params.end())
+            throw std::runtime_error("unknown parameter " + p + " for " + layoutName);
+        it->second(p.substr(eq + 1));
+    }
+
+    auto start = Clock::now();
+    Graph g;
+    if (!input.empty()) {
+        loadGraphPath(g, input, cache);
+    } else if (generator == "grid") {
+        auto [w, h] = parseDims(genArg);
+        buildGrid(g, w, h);
+    } else if (generator == "torus") {
+        auto [n, m] = parseDims(genArg);
+        buildTorus(g, n, m);
+    } else if (generator == "sierpinski") {
+        buildSierpinski(g, std::stoi(genArg));
+    } else {
+        usage();
+        return 1;
+    }
+    double loadTime = seconds(start);
+    std::cout << "graph: " << g.nodes.size() << " nodes, " << g.getEdgeCount() << " edges\n";
+
+    if (!warm)
+        g.randomizePos(width, height, seed);
+
+    Layout& layout = *choice.layout;
+    start = Clock::now();
+    layout.init(g);
+    double initTime = seconds(start);
+    start = Clock::now();
+    while (!layout.converged())
+        layout.step(64);
+    layout.store(g);
+    double layoutTime = seconds(start);
+
+    const LayoutState& s = layout.state();
+    std::cout << "layout: " << layoutName << ", " << s.iteration << " steps, residual " << s.residual << '\n';
+    std::cout << "time: load " << loadTime << " s, init " << initTime << " s, layout " << layoutTime << " s\n";
+
+    if (!output.empty()) {
+        start = Clock::now();
+        writePositions(g, output);
+        std::cout << "wrote " << output << " in " << seconds(start) << " s\n";
+    }
+    if (!saveGlc.empty()) {
+        start = Clock::now();
+        GraphCache::write(g, saveGlc, true);
+        std::cout << "wrote " << saveGlc << " in " << seconds(start) << " s\n";
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    try {
+        return run(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << "error: " << e.what() << '\n';
+        return 1;
+    }
+}
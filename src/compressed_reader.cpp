@@ -0,0 +1,212 @@
+#include "compressed_reader.hpp"
+#include "bounded_queue.hpp"
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifdef GRAPH_LAYOUT_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef GRAPH_LAYOUT_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+constexpr size_t CHUNK_BYTES = 4 << 20;
+// Buffers in flight: one being filled, one being parsed, two queued
+constexpr size_t CHUNK_COUNT = 4;
+
+// Writes up to size decompressed bytes to out, returns how many, 0 at the
+// end of the stream
+class Decompressor {
+
+  public:
+    virtual ~Decompressor() = default;
+    virtual size_t read(char* out, size_t size) = 0;
+};
+
+#ifdef GRAPH_LAYOUT_HAVE_ZLIB
+class GzipDecompressor : public Decompressor {
+
+  public:
+    explicit GzipDecompressor(const std::string& path) : file_(gzopen(path.c_str(), "rb")) {
+        if (!file_)
+            throw std::runtime_error("failed to open file");
+        gzbuffer(file_, 1 << 20);
+    }
+    ~GzipDecompressor() override { gzclose(file_); }
+
+    size_t read(char* out, size_t size) override {
+        int n = gzread(file_, out, static_cast<unsigned>(size));
+        // short reads end the file, gzerror tells a clean end from a
+        // truncated stream (Z_BUF_ERROR)
+        if (n < 0 || static_cast<size_t>(n) < size) {
+            int err;
+            const char* message = gzerror(file_, &err);
+            if (err != Z_OK)
+                throw std::runtime_error(std::string("gzip: ") + message);
+        }
+        return n;
+    }
+
+  private:
+    gzFile file_;
+};
+#endif
+
+#ifdef GRAPH_LAYOUT_HAVE_ZSTD
+class ZstdDecompressor : public Decompressor {
+
+  public:
+    explicit ZstdDecompressor(const std::string& path)
+        : file_(std::fopen(path.c_str(), "rb")), ctx_(ZSTD_createDCtx()), in_(ZSTD_DStreamInSize()) {
+        if (!file_)
+            throw std::runtime_error("failed to open file");
+    }
+    ~ZstdDecompressor() override {
+        ZSTD_freeDCtx(ctx_);
+        std::fclose(file_);
+    }
+
+    size_t read(char* out, size_t size) override {
+        ZSTD_outBuffer output{out, size, 0};
+        while (output.pos < output.size) {
+            if (input_.pos == input_.size && !eof_) {
+                size_t n = std::fread(in_.data(), 1, in_.size(), file_);
+                if (n == 0)
+                    eof_ = true;
+                else
+                    input_ = {in_.data(), n, 0};
+            }
+            // a frame is complete and flushed once the result is 0
+            if (eof_ && lastResult_ == 0)
+                break;
+            // past the end of the file the context may still hold decoded
+            // data, it is flushed by calls with empty input
+            size_t before = output.pos;
+            lastResult_ = ZSTD_decompressStream(ctx_, &output, &input_);
+            if (ZSTD_isError(lastResult_))
+                throw std::runtime_error(std::string("zstd: ") + ZSTD_getErrorName(lastResult_));
+            if (eof_ && lastResult_ != 0 && output.pos == before)
+                throw std::runtime_error("zstd: truncated input");
+        }
+        return output.pos;
+    }
+
+  private:
+    FILE* file_;
+    ZSTD_DCtx* ctx_;
+    std::vector<char> in_;
+    ZSTD_inBuffer input_{nullptr, 0, 0};
+    size_t lastResult_ = 0;
+    bool eof_ = false;
+};
+#endif
+
+std::unique_ptr<Decompressor> openDecompressor(const std::string& path) {
+    std::string ext = std::filesystem::path(path).extension().string();
+    if (ext == ".gz") {
+#ifdef GRAPH_LAYOUT_HAVE_ZLIB
+        return std::make_unique<GzipDecompressor>(path);
+#else
+        throw std::runtime_error("built without gzip support");
+#endif
+    }
+#ifdef GRAPH_LAYOUT_HAVE_ZSTD
+    return std::make_unique<ZstdDecompressor>(path);
+#else
+    throw std::runtime_error("built without zstd support");
+#endif
+}
+
+} // namespace
+
+bool isCompressed(const std::string& path) {
+    std::string ext = std::filesystem::path(path).extension().string();
+    return ext == ".gz" || ext == ".zst";
+}
+
+std::string innerExtension(const std::string& path) {
+    std::filesystem::path p(path);
+    return isCompressed(path) ? p.stem().extension().string() : p.extension().string();
+}
+
+void readCompressedLines(const std::string& path,
+                         const std::function<void(const char*, const char*)>& onLines) {
+    // Opened here so that a missing file or format fails before any thread
+    std::unique_ptr<Decompressor> source = openDecompressor(path);
+
+    BoundedQueue<std::string> empty(CHUNK_COUNT);
+    BoundedQueue<std::string> full(CHUNK_COUNT);
+    for (size_t i = 0; i < CHUNK_COUNT; ++i)
+        empty.push(std::string());
+
+    std::exception_ptr error;
+    std::thread producer([&] {
+        try {
+            std::string buf;
+            while (empty.pop(buf)) {
+                // buffers come back at full size, so only a short last chunk
+                // pays for a fill. Not resize_and_overwrite, read() may throw.
+                buf.resize(CHUNK_BYTES);
+                buf.resize(source->read(buf.data(), buf.size()));
+                if (buf.empty())
+                    break;
+                if (!full.push(std::move(buf)))
+                    break;
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+        full.close();
+    });
+    // Stops the producer when onLines throws, too
+    struct Join {
+        BoundedQueue<std::string>& empty;
+        BoundedQueue<std::string>& full;
+        std::thread& thread;
+        ~Join() {
+            empty.close();
+            full.close();
+            thread.join();
+        }
+    } join{empty, full, producer};
+
+    // A line cut by a chunk boundary is completed in carry, whole lines are
+    // passed straight from the chunk
+    std::string carry;
+    std::string buf;
+    while (full.pop(buf)) {
+        const char* p = buf.data();
+        const char* end = p + buf.size();
+        const void* firstNl = std::memchr(p, '\n', end - p);
+        if (!firstNl) {
+            carry.append(p, end);
+        } else {
+            const char* first = static_cast<const char*>(firstNl) + 1;
+            if (!carry.empty()) {
+                carry.append(p, first);
+                onLines(carry.data(), carry.data() + carry.size());
+                carry.clear();
+                p = first;
+            }
+            size_t nl = std::string_view(p, end - p).rfind('\n');
+            const char* last = nl == std::string_view::npos ? p : p + nl + 1;
+            if (p < last)
+                onLines(p, last);
+            carry.assign(last, end);
+        }
+        empty.push(std::move(buf));
+    }
+    if (error)
+        std::rethrow_exception(error);
+    if (!carry.empty())
+        onLines(carry.data(), carry.data() + carry.size());
+}
@@ -0,0 +1,105 @@
+#include "distance_matrix.hpp"
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+DistanceMatrix::DistanceMatrix(size_t n, bool symmetric, Storage storage, float unit)
+    : n_(n), symmetric_(symmetric), storage_(storage), unit_(unit) {
+    const size_t count = symmetric ? n * (n + 1) / 2 : n * n;
+    switch (storage_) {
+    case Storage::Float:
+        f32_.assign(count, std::numeric_limits<float>::infinity());
+        break;
+    case Storage::U16:
+        u16_.assign(count, std::numeric_limits<uint16_t>::max());
+        break;
+    case Storage::U8:
+        u8_.assign(count, std::numeric_limits<uint8_t>::max());
+        break;
+    }
+}
+
+size_t DistanceMatrix::bytes() const {
+    return f32_.size() * sizeof(float) + u16_.size() * sizeof(uint16_t) + u8_.size();
+}
+
+size_t DistanceMatrix::maxHops(Storage storage) {
+    switch (storage) {
+    case Storage::U16:
+        return std::numeric_limits<uint16_t>::max() - 1;
+    case Storage::U8:
+        return std::numeric_limits<uint8_t>::max() - 1;
+    default:
+        return std::numeric_limits<size_t>::max();
+    }
+}
+
+void DistanceMatrix::set(size_t i, size_t j, float d) {
+    const size_t k = index(i, j);
+    switch (storage_) {
+    case Storage::Float:
+        f32_[k] = d;
+        break;
+    case Storage::U16:
+        u16_[k] = std::isfinite(d) ? static_cast<uint16_t>(std::lround(d / unit_))
+                                   : std::numeric_limits<uint16_t>::max();
+        break;
+    case Storage::U8:
+        u8_[k] = std::isfinite(d) ? static_cast<uint8_t>(std::lround(d / unit_))
+                                  : std::numeric_limits<uint8_t>::max();
+        break;
+    }
+}
+
+template <typename T> void DistanceMatrix::decodeRow(const std::vector<T>& data, size_t i, float* out) const {
+    auto value = [&](T code) {
+        if constexpr (std::is_same_v<T, float>)
+            return code;
+        else
+            return decode(code, std::numeric_limits<T>::max());
+    };
+
+    if (!symmetric_) {
+        const T* row = data.data() + i * n_;
+        for (size_t j = 0; j < n_; ++j)
+            out[j] = value(row[j]);
+        return;
+    }
+    // Column part above the diagonal, then the contiguous row tail
+    for (size_t j = 0; j < i; ++j)
+        out[j] = value(data[index(j, i)]);
+    const T* tail = data.data() + index(i, i);
+    for (size_t j = i; j < n_; ++j)
+        out[j] = value(tail[j - i]);
+}
+
+void DistanceMatrix::row(size_t i, float* out) const {
+    switch (storage_) {
+    case Storage::Float:
+        decodeRow(f32_, i, out);
+        break;
+    case Storage::U16:
+        decodeRow(u16_, i, out);
+        break;
+    case Storage::U8:
+        decodeRow(u8_, i, out);
+        break;
+    }
+}
+
+float DistanceMatrix::maxFinite() const {
+    float maxDist = 0.0f;
+    for (float d : f32_)
+        if (d < std::numeric_limits<float>::infinity())
+            maxDist = std::max(maxDist, d);
+
+    uint32_t maxCode = 0;
+    for (uint16_t c : u16_)
+        if (c != std::numeric_limits<uint16_t>::max())
+            maxCode = std::max<uint32_t>(maxCode, c);
+    for (uint8_t c : u8_)
+        if (c != std::numeric_limits<uint8_t>::max())
+            maxCode = std::max<uint32_t>(maxCode, c);
+
+    return std::max(maxDist, static_cast<float>(maxCode) * unit_);
+}
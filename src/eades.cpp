@@ -1,44 +1,38 @@
-
 #include "eades.hpp"
 #include "graph.hpp"
 #include <algorithm>
 #include <cmath>
+#include <iostream>
 
-void Eades::apply(Graph& g) {
-    auto V = g.nodes.size();
-
-    for (int iter = 0; iter < cfg_.max_iter; ++iter) {
-        g.resetForces();
+void Eades::init(const Graph& g) {
+    state_ = {};
+    if (csr_.topologyVersion != g.topologyVersion || csr_.nodeCount() != g.nodes.size())
+        csr_.build(g);
+    buf_.load(g);
 
-        // Repulsive forces
-        for (size_t i = 0; i < V; ++i) {
-            for (size_t j = i + 1; j < V; ++j) {
-                Node& vi = g.nodes[i];
-                Node& vj = g.nodes[j];
+    const char* kernelName = "scalar";
+    repulsion_ = cfg_.simd ? selectEadesRepulsion(&kernelName) : eadesRepulsionScalar;
+    std::clog << ">> Computing Eades (" << kernelName << " repulsion)\n";
+}
 
-                float dx = vi.x - vj.x;
-                float dy = vi.y - vj.y;
-                float dist2 = dx * dx + dy * dy;
-                float dist = std::sqrt(std::max(dist2, EPSILON));
-                dist = std::max(dist, EPSILON);
+float Eades::step(int n) {
+    const size_t V = buf_.size();
+    float* xs = buf_.xs.data();
+    float* ys = buf_.ys.data();
+    float* fxs = buf_.fxs.data();
+    float* fys = buf_.fys.data();
 
-                float force = repelForce(dist);
-                float fx = (dx / dist) * force;
-                float fy = (dy / dist) * force;
+    for (int k = 0; k < n && !converged(); ++k) {
+        buf_.resetForces();
 
-                vi.dx += fx;
-                vi.dy += fy;
-                vj.dx -= fx;
-                vj.dy -= fy;
-            }
-
-            // Attractive forces
-            for (const auto& e : g.adj[i]) {
-                Node& src = g.nodes[i];
-                Node& dst = g.nodes[e.dst];
+        // Repulsive forces
+        repulsion_(xs, ys, fxs, fys, V, cfg_.c3);
 
-                float dx = src.x - dst.x;
-                float dy = src.y - dst.y;
+        // Attractive forces
+        for (size_t i = 0; i < V; ++i) {
+            for (int j : csr_.neighbors(i)) {
+                float dx = xs[i] - xs[j];
+                float dy = ys[i] - ys[j];
                 float dist2 = dx * dx + dy * dy;
                 float dist = std::sqrt(std::max(dist2, EPSILON));
                 dist = std::max(dist, EPSILON);
@@ -47,27 +41,34 @@ void Eades::apply(Graph& g) {
                 float fx = (dx / dist) * force;
                 float fy = (dy / dist) * force;
 
-                src.dx -= fx;
-                src.dy -= fy;
-                if (!g.directed) {
-                    dst.dx += fx;
-                    dst.dy += fy;
+                fxs[i] -= fx;
+                fys[i] -= fy;
+                if (!csr_.directed) {
+                    fxs[j] += fx;
+                    fys[j] += fy;
                 }
             }
         }
 
         // Update positions
-        for (auto& node : g.nodes) {
-            node.x += cfg_.c4 * node.dx;
-            node.y += cfg_.c4 * node.dy;
+        float moved = 0.0f;
+#pragma omp simd reduction(+ : moved)
+        for (size_t i = 0; i < V; ++i) {
+            xs[i] += cfg_.c4 * fxs[i];
+            ys[i] += cfg_.c4 * fys[i];
+            moved += cfg_.c4 * std::sqrt(fxs[i] * fxs[i] + fys[i] * fys[i]);
         }
+
+        state_.residual = moved / V;
+        state_.iteration++;
+        state_.progress = float(state_.iteration) / cfg_.max_iter;
     }
+    return state_.residual;
 }
 
-float Eades::repelForce(float d) {
-    d = std::max(d, EPSILON);
-    return cfg_.c3 / (d * d);
-}
+bool Eades::converged() const { return buf_.size() == 0 || state_.iteration >= cfg_.max_iter; }
+
+void Eades::store(Graph& g) const { buf_.store(g); }
 
 float Eades::attractForce(float d) {
     d = std::max(d, EPSILON);
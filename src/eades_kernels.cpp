@@ -0,0 +1,192 @@
+#include "eades_kernels.hpp"
+#include "layout.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define EADES_X86 1
+#endif
+
+namespace {
+
+// j-block kept in L1: 4 arrays of TILE floats
+constexpr size_t TILE = 1024;
+
+} // namespace
+
+void eadesRepulsionScalar(const float* xs, const float* ys, float* fxs, float* fys, size_t n, float c3) {
+    for (size_t i = 0; i < n; ++i) {
+        const float xi = xs[i];
+        const float yi = ys[i];
+        float fxi = 0.0f;
+        float fyi = 0.0f;
+
+#pragma omp simd reduction(+ : fxi, fyi)
+        for (size_t j = i + 1; j < n; ++j) {
+            float dx = xi - xs[j];
+            float dy = yi - ys[j];
+            float dist2 = std::max(dx * dx + dy * dy, EPSILON);
+            float dist = std::sqrt(dist2);
+
+            // (dx / dist) * c3 / dist^2
+            float scale = c3 / (dist2 * dist);
+            float fx = dx * scale;
+            float fy = dy * scale;
+
+            fxi += fx;
+            fyi += fy;
+            fxs[j] -= fx;
+            fys[j] -= fy;
+        }
+        fxs[i] += fxi;
+        fys[i] += fyi;
+    }
+}
+
+#ifdef EADES_X86
+
+__attribute__((target("avx2,fma"))) static inline float hsum256(__m256 v) {
+    __m128 lo = _mm256_castps256_ps128(v);
+    __m128 hi = _mm256_extractf128_ps(v, 1);
+    lo = _mm_add_ps(lo, hi);
+    lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+    lo = _mm_add_ss(lo, _mm_movehdup_ps(lo));
+    return _mm_cvtss_f32(lo);
+}
+
+__attribute__((target("avx2,fma"))) void eadesRepulsionAvx2(const float* xs, const float* ys, float* fxs,
+                                                            float* fys, size_t n, float c3) {
+    const __m256 eps = _mm256_set1_ps(EPSILON);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 threeHalves = _mm256_set1_ps(1.5f);
+    const __m256 vc3 = _mm256_set1_ps(c3);
+
+    for (size_t jb = 0; jb < n; jb += TILE) {
+        const size_t jend = std::min(jb + TILE, n);
+        for (size_t i = 0; i + 1 < jend; ++i) {
+            size_t j = std::max(i + 1, jb);
+            const float xi = xs[i];
+            const float yi = ys[i];
+            const __m256 vxi = _mm256_set1_ps(xi);
+            const __m256 vyi = _mm256_set1_ps(yi);
+            __m256 accx = _mm256_setzero_ps();
+            __m256 accy = _mm256_setzero_ps();
+
+            for (; j + 8 <= jend; j += 8) {
+                __m256 dx = _mm256_sub_ps(vxi, _mm256_loadu_ps(xs + j));
+                __m256 dy = _mm256_sub_ps(vyi, _mm256_loadu_ps(ys + j));
+                __m256 d2 = _mm256_fmadd_ps(dx, dx, _mm256_mul_ps(dy, dy));
+                d2 = _mm256_max_ps(d2, eps);
+
+                // r = 1 / sqrt(d2), one Newton step: r * (1.5 - 0.5 * d2 * r^2)
+                __m256 r = _mm256_rsqrt_ps(d2);
+                __m256 hd2 = _mm256_mul_ps(half, d2);
+                r = _mm256_mul_ps(r, _mm256_fnmadd_ps(hd2, _mm256_mul_ps(r, r), threeHalves));
+
+                __m256 scale = _mm256_mul_ps(vc3, _mm256_mul_ps(r, _mm256_mul_ps(r, r)));
+                __m256 fx = _mm256_mul_ps(dx, scale);
+                __m256 fy = _mm256_mul_ps(dy, scale);
+
+                accx = _mm256_add_ps(accx, fx);
+                accy = _mm256_add_ps(accy, fy);
+                _mm256_storeu_ps(fxs + j, _mm256_sub_ps(_mm256_loadu_ps(fxs + j), fx));
+                _mm256_storeu_ps(fys + j, _mm256_sub_ps(_mm256_loadu_ps(fys + j), fy));
+            }
+
+            float fxi = hsum256(accx);
+            float fyi = hsum256(accy);
+            for (; j < jend; ++j) {
+                float dx = xi - xs[j];
+                float dy = yi - ys[j];
+                float dist2 = std::max(dx * dx + dy * dy, EPSILON);
+                float scale = c3 / (dist2 * std::sqrt(dist2));
+                float fx = dx * scale;
+                float fy = dy * scale;
+                fxi += fx;
+                fyi += fy;
+                fxs[j] -= fx;
+                fys[j] -= fy;
+            }
+            fxs[i] += fxi;
+            fys[i] += fyi;
+        }
+    }
+}
+
+// GCC reports false positives from _mm512_undefined_ps inside the intrinsic headers
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+__attribute__((target("avx512f"))) void eadesRepulsionAvx512(const float* xs, const float* ys, float* fxs,
+                                                             float* fys, size_t n, float c3) {
+    const __m512 eps = _mm512_set1_ps(EPSILON);
+    const __m512 half = _mm512_set1_ps(0.5f);
+    const __m512 threeHalves = _mm512_set1_ps(1.5f);
+    const __m512 vc3 = _mm512_set1_ps(c3);
+
+    for (size_t jb = 0; jb < n; jb += TILE) {
+        const size_t jend = std::min(jb + TILE, n);
+        for (size_t i = 0; i + 1 < jend; ++i) {
+            const __m512 vxi = _mm512_set1_ps(xs[i]);
+            const __m512 vyi = _mm512_set1_ps(ys[i]);
+            __m512 accx = _mm512_setzero_ps();
+            __m512 accy = _mm512_setzero_ps();
+
+            for (size_t j = std::max(i + 1, jb); j < jend; j += 16) {
+                // Masked tail, inactive lanes contribute nothing
+                const __mmask16 m = jend - j >= 16 ? 0xFFFF : static_cast<__mmask16>((1u << (jend - j)) - 1);
+                __m512 dx = _mm512_sub_ps(vxi, _mm512_maskz_loadu_ps(m, xs + j));
+                __m512 dy = _mm512_sub_ps(vyi, _mm512_maskz_loadu_ps(m, ys + j));
+                __m512 d2 = _mm512_fmadd_ps(dx, dx, _mm512_mul_ps(dy, dy));
+                d2 = _mm512_max_ps(d2, eps);
+
+                __m512 r = _mm512_rsqrt14_ps(d2);
+                __m512 hd2 = _mm512_mul_ps(half, d2);
+                r = _mm512_mul_ps(r, _mm512_fnmadd_ps(hd2, _mm512_mul_ps(r, r), threeHalves));
+
+                __m512 scale = _mm512_mul_ps(vc3, _mm512_mul_ps(r, _mm512_mul_ps(r, r)));
+                __m512 fx = _mm512_maskz_mul_ps(m, dx, scale);
+                __m512 fy = _mm512_maskz_mul_ps(m, dy, scale);
+
+                accx = _mm512_add_ps(accx, fx);
+                accy = _mm512_add_ps(accy, fy);
+                _mm512_mask_storeu_ps(fxs + j, m, _mm512_sub_ps(_mm512_maskz_loadu_ps(m, fxs + j), fx));
+                _mm512_mask_storeu_ps(fys + j, m, _mm512_sub_ps(_mm512_maskz_loadu_ps(m, fys + j), fy));
+            }
+            fxs[i] += _mm512_reduce_add_ps(accx);
+            fys[i] += _mm512_reduce_add_ps(accy);
+        }
+    }
+}
+#pragma GCC diagnostic pop
+
+std::vector<EadesKernelInfo> availableEadesRepulsion() {
+    __builtin_cpu_init();
+    std::vector<EadesKernelInfo> kernels{{"scalar", eadesRepulsionScalar}};
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        kernels.push_back({"avx2", eadesRepulsionAvx2});
+    if (__builtin_cpu_supports("avx512f"))
+        kernels.push_back({"avx512", eadesRepulsionAvx512});
+    return kernels;
+}
+
+#else
+
+void eadesRepulsionAvx2(const float* xs, const float* ys, float* fxs, float* fys, size_t n, float c3) {
+    eadesRepulsionScalar(xs, ys, fxs, fys, n, c3);
+}
+
+void eadesRepulsionAvx512(const float* xs, const float* ys, float* fxs, float* fys, size_t n, float c3) {
+    eadesRepulsionScalar(xs, ys, fxs, fys, n, c3);
+}
+
+std::vector<EadesKernelInfo> availableEadesRepulsion() { return {{"scalar", eadesRepulsionScalar}}; }
+
+#endif
+
+EadesRepulsionKernel selectEadesRepulsion(const char** name) {
+    EadesKernelInfo best = availableEadesRepulsion().back();
+    if (name)
+        *name = best.name;
+    return best.kernel;
+}
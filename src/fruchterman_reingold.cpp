@@ -4,40 +4,96 @@
 #include <cmath>
 #include <iostream>
 
-void FruchtermanReingold::computeRepulsiveForces(Graph& g) {
+void FruchtermanReingold::computeRepulsiveForces() {
 
-    const size_t V = g.nodes.size();
+    const size_t V = buf_.size();
+    const float* xs = buf_.xs.data();
+    const float* ys = buf_.ys.data();
+    const float k2 = K_ * K_;
     for (size_t i = 0; i < V; ++i) {
-        Node& vi = g.nodes[i];
+        const float xi = xs[i];
+        const float yi = ys[i];
+        float fx = 0.0f;
+        float fy = 0.0f;
+        // i == j contributes nothing since dx = dy = 0
+#pragma omp simd reduction(+ : fx, fy)
         for (size_t j = 0; j < V; ++j) {
-            if (i == j) {
-                continue;
-            }
-            Node& vj = g.nodes[j];
+            float dx = xi - xs[j];
+            float dy = yi - ys[j];
+            float dist2 = std::max(dx * dx + dy * dy, EPSILON);
+
+            // (dx / dist) * fr(dist, K_)
+            float scale = k2 / dist2;
+            fx += dx * scale;
+            fy += dy * scale;
+        }
+        buf_.fxs[i] += fx;
+        buf_.fys[i] += fy;
+    }
+}
+void FruchtermanReingold::computeRepulsiveForcesBarnesHut() {
+    const size_t V = buf_.size();
+    tree_.build(buf_.xs.data(), buf_.ys.data(), V);
 
-            float dx = vi.x - vj.x;
-            float dy = vi.y - vj.y;
+    for (size_t i = 0; i < V; ++i) {
+        const float xi = buf_.xs[i];
+        const float yi = buf_.ys[i];
+        float fx = 0.0f;
+        float fy = 0.0f;
+        tree_.forEachInteraction(xi, yi, cfg_.theta, [&](float x, float y, float mass) {
+            float dx = xi - x;
+            float dy = yi - y;
             float dist2 = dx * dx + dy * dy;
             float dist = std::sqrt(std::max(dist2, EPSILON));
 
-            float force = fr(dist, K_);
-            float fx = (dx / dist) * force;
-            float fy = (dy / dist) * force;
-
-            vi.dx += fx;
-            vi.dy += fy;
-        }
+            float force = mass * fr(dist, K_);
+            fx += (dx / dist) * force;
+            fy += (dy / dist) * force;
+        });
+        buf_.fxs[i] += fx;
+        buf_.fys[i] += fy;
     }
 }
-void FruchtermanReingold::computeAttractiveForces(Graph& g) {
-    const size_t V = g.nodes.size();
+// Grid variant from the original paper: only nodes closer than 2k repel
+void FruchtermanReingold::computeRepulsiveForcesGrid() {
+    const size_t V = buf_.size();
+    const float* xs = buf_.xs.data();
+    const float* ys = buf_.ys.data();
+    const float radius = 2.0f * K_;
+    const float radius2 = radius * radius;
+    grid_.build(xs, ys, V, radius);
+
     for (size_t i = 0; i < V; ++i) {
-        Node& src = g.nodes[i];
-        for (const auto& e : g.adj[i]) {
-            Node& dst = g.nodes[e.dst];
+        const float xi = xs[i];
+        const float yi = ys[i];
+        float fx = 0.0f;
+        float fy = 0.0f;
+        grid_.forEachNeighbor(xi, yi, [&](int j) {
+            float dx = xi - xs[j];
+            float dy = yi - ys[j];
+            float dist2 = dx * dx + dy * dy;
+            if (dist2 >= radius2)
+                return;
+            float dist = std::sqrt(std::max(dist2, EPSILON));
 
-            float dx = src.x - dst.x;
-            float dy = src.y - dst.y;
+            float force = fr(dist, K_);
+            fx += (dx / dist) * force;
+            fy += (dy / dist) * force;
+        });
+        buf_.fxs[i] += fx;
+        buf_.fys[i] += fy;
+    }
+}
+void FruchtermanReingold::computeAttractiveForces() {
+    const size_t V = buf_.size();
+    float* xs = buf_.xs.data();
+    float* ys = buf_.ys.data();
+    float* fxs = buf_.fxs.data();
+    float* fys = buf_.fys.data();
+    for (size_t i = 0; i < V; ++i) {
+        for (int j : csr_.neighbors(i)) {
+            float dx = xs[i] - xs[j];
+            float dy = ys[i] - ys[j];
             float dist2 = dx * dx + dy * dy;
             float dist = std::sqrt(std::max(dist2, EPSILON));
 
@@ -45,57 +101,84 @@ void FruchtermanReingold::computeAttractiveForces(Graph& g) {
             float fx = (dx / dist) * force;
             float fy = (dy / dist) * force;
 
-            src.dx -= fx;
-            src.dy -= fy;
-            if (!g.directed) {
-                dst.dx += fx;
-                dst.dy += fy;
+            fxs[i] -= fx;
+            fys[i] -= fy;
+            if (!csr_.directed) {
+                fxs[j] += fx;
+                fys[j] += fy;
             }
         }
     }
 }
-void FruchtermanReingold::updatePositions(Graph& g) {
-    for (auto& n : g.nodes) {
-        float dx = n.dx;
-        float dy = n.dy;
+float FruchtermanReingold::updatePositions() {
+    const size_t V = buf_.size();
+    float* xs = buf_.xs.data();
+    float* ys = buf_.ys.data();
+    const float* fxs = buf_.fxs.data();
+    const float* fys = buf_.fys.data();
+    float moved = 0.0f;
+#pragma omp simd reduction(+ : moved)
+    for (size_t i = 0; i < V; ++i) {
+        float dx = fxs[i];
+        float dy = fys[i];
         float disp2 = dx * dx + dy * dy;
         float disp = std::sqrt(disp2);
 
-        if (disp > EPSILON) {
-            float move = std::min(disp, T_);
-            n.x += (dx / disp) * move;
-            n.y += (dy / disp) * move;
-        }
+        float move = std::min(disp, T_);
+        float scale = disp > EPSILON ? move / disp : 0.0f;
+        xs[i] += dx * scale;
+        ys[i] += dy * scale;
+        moved += move;
 
         // n.x = std::clamp(n.x, -mx_ / 2.0f, mx_ / 2.0f);
         // n.y = std::clamp(n.y, -my_ / 2.0f, my_ / 2.0f);
     }
+    return V ? moved / V : 0.0f;
 }
 
-void FruchtermanReingold::apply(Graph& g) {
-
+void FruchtermanReingold::init(const Graph& g) {
     std::clog << ">> Computing Fruchterman Reingold\n";
     const size_t V = g.nodes.size();
-    if (V == 0) {
-        return;
-    }
+    state_ = {};
     A_ = cfg_.mx * cfg_.my;
-    K_ = cfg_.C * std::sqrt(A_ / static_cast<float>(V));
+    K_ = cfg_.C * std::sqrt(A_ / static_cast<float>(std::max<size_t>(V, 1)));
     T_ = cfg_.mx / 10.0f;
-    I_ = 0;
+    if (csr_.topologyVersion != g.topologyVersion || csr_.nodeCount() != V)
+        csr_.build(g);
+    buf_.load(g);
 
     std::clog << "T initial: " << T_ << '\n';
+}
 
-    for (int iter = 0; iter < cfg_.max_iter; ++iter) {
-        g.resetForces();
+float FruchtermanReingold::step(int n) {
+    for (int k = 0; k < n && !converged(); ++k) {
+        int iter = state_.iteration;
+        buf_.resetForces();
         if (iter % 100 == 0) {
             std::clog << "Iteration: " << iter << '\n';
         }
 
-        computeRepulsiveForces(g);
-        computeAttractiveForces(g);
-        updatePositions(g);
+        switch (cfg_.mode) {
+        case RepulsionMode::Exact:
+            computeRepulsiveForces();
+            break;
+        case RepulsionMode::BarnesHut:
+            computeRepulsiveForcesBarnesHut();
+            break;
+        case RepulsionMode::Grid:
+            computeRepulsiveForcesGrid();
+            break;
+        }
+        computeAttractiveForces();
+        state_.residual = updatePositions();
 
         T_ = cool(T_);
+        state_.iteration++;
+        state_.progress = float(state_.iteration) / cfg_.max_iter;
     }
+    return state_.residual;
 }
+
+bool FruchtermanReingold::converged() const { return buf_.size() == 0 || state_.iteration >= cfg_.max_iter; }
+
+void FruchtermanReingold::store(Graph& g) const { buf_.store(g); }
@@ -1,19 +1,45 @@
 #include "graph.hpp"
+#include "graph_csr.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
 #include <iostream>
-#include <queue>
+#include <limits>
 #include <random>
+#include <stdexcept>
 #include <vector>
 
+uint64_t Graph::nextVersion() {
+    static std::atomic<uint64_t> counter{0};
+    return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
 size_t Graph::addNode(int id) {
-    auto it = idToIndex.find(id);
-    if (it != idToIndex.end())
-        return it->second;
+    if (denseIds) {
+        if (id >= 0 && static_cast<size_t>(id) < nodes.size())
+            return id;
+        if (static_cast<size_t>(id) != nodes.size()) {
+            // first id out of sequence, from now on ids go through the map
+            denseIds = false;
+            idToIndex.reserve(nodes.size() + 1);
+            for (size_t v = 0; v < nodes.size(); ++v)
+                idToIndex[nodes[v].id] = v;
+        }
+    }
+    if (!denseIds) {
+        auto it = idToIndex.find(id);
+        if (it != idToIndex.end())
+            return it->second;
+    }
 
     size_t index = nodes.size();
     nodes.emplace_back(Node{id});
 
     adj.emplace_back();
-    idToIndex[id] = index;
+    if (!denseIds)
+        idToIndex[id] = index;
+    topologyVersion = nextVersion();
 
     return index;
 }
@@ -26,11 +52,20 @@ void Graph::addEdge(int src, int dest, float weight) {
     if (!directed) {
         adj[dest_idx].emplace_back(NodeAdj{src_idx, weight});
     }
+    topologyVersion = nextVersion();
+}
+
+size_t Graph::indexOf(int id) const {
+    if (!denseIds)
+        return idToIndex.at(id);
+    if (id < 0 || static_cast<size_t>(id) >= nodes.size())
+        throw std::out_of_range("unknown node id");
+    return id;
 }
 
 std::vector<int> Graph::getNeighbords(const int n) {
     std::vector<int> neighbord;
-    int idx = idToIndex.at(n);
+    int idx = indexOf(n);
     for (const auto& n_i : adj[idx]) {
         int node = nodes[n_i.dst].id;
         neighbord.push_back(node);
@@ -68,15 +103,17 @@ void Graph::print() {
 }
 
 // FIXME: move to layout
-void Graph::randomizePos(float w, float h) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
+void Graph::randomizePos(float w, float h) { randomizePos(w, h, std::random_device{}()); }
+
+void Graph::randomizePos(float w, float h, unsigned seed) {
+    std::mt19937 gen(seed);
     std::uniform_real_distribution<float> dist_x(-w / 2.0f, w / 2.0f);
     std::uniform_real_distribution<float> dist_y(-h / 2.0f, h / 2.0f);
     for (auto& n : nodes) {
         n.x = dist_x(gen);
         n.y = dist_y(gen);
     }
+    positionVersion = nextVersion();
 }
 
 // FIXME: move to layout
@@ -100,6 +137,7 @@ void Graph::gridLayout(float width, float height, int cols) {
         nodes[i].x = c * cell_width - width / 2 + cell_width / 2;
         nodes[i].y = r * cell_height - height / 2 + cell_height / 2;
     }
+    positionVersion = nextVersion();
 }
 void Graph::resetForces() {
     for (auto& n : nodes) {
@@ -109,43 +147,184 @@ void Graph::resetForces() {
 }
 
 void Graph::dijkstra(int src, std::vector<float>& dist) {
-    std::fill(dist.begin(), dist.end(), std::numeric_limits<float>::infinity());
-    dist[src] = 0.0f;
+    DijkstraHeap heap;
+    dist.resize(nodes.size());
+    dijkstra(GraphCSR(*this), src, dist.data(), heap);
+}
 
-    using PQItem = std::pair<float, size_t>;
-    std::priority_queue<PQItem, std::vector<PQItem>, std::greater<>> pq;
-    pq.push({0.0f, src});
+// Heap kept by the caller, so repeated runs do not allocate
+void Graph::dijkstra(const GraphCSR& csr, int src, float* dist, DijkstraHeap& heap) {
+    std::fill(dist, dist + csr.nodeCount(), std::numeric_limits<float>::infinity());
+    dist[src] = 0.0f;
 
-    while (!pq.empty()) {
-        auto [d, u] = pq.top();
-        pq.pop();
+    heap.resize(csr.nodeCount());
+    heap.clear();
+    heap.push(src, 0.0f);
 
-        if (d > dist[u])
-            continue;
+    while (!heap.empty()) {
+        int u = heap.pop();
 
-        for (const auto& neighbor : adj[u]) {
-            size_t v = neighbor.dst;
-            float alt = dist[u] + neighbor.weight;
+        for (size_t k = csr.offsets[u]; k < csr.offsets[u + 1]; ++k) {
+            int v = csr.dst[k];
+            float alt = dist[u] + csr.weight[k];
 
             if (alt < dist[v]) {
                 dist[v] = alt;
-                pq.push({alt, v});
+                if (heap.contains(v))
+                    heap.update(v, alt);
+                else
+                    heap.push(v, alt);
+            }
+        }
+    }
+}
+
+namespace {
+
+// Scratch bitsets for one batch of up to 64 BFS sources, bit b of a node's
+// word stands for source (first + b)
+struct BfsBatch {
+    std::vector<uint64_t> visited;
+    std::vector<uint64_t> frontier;
+    std::vector<uint64_t> next;
+};
+
+// Multi-source BFS for graphs where every edge has weight w. Distances are
+// accumulated level by level (0 + w + w ...), the same sums Dijkstra builds.
+void bitParallelBfs(const GraphCSR& csr, size_t first, float w, BfsBatch& s, DistanceMatrix& allPairs) {
+    const size_t V = csr.nodeCount();
+    const size_t count = std::min<size_t>(64, V - first);
+    s.visited.assign(V, 0);
+    s.frontier.assign(V, 0);
+    s.next.resize(V);
+
+    for (size_t b = 0; b < count; ++b) {
+        s.visited[first + b] = uint64_t(1) << b;
+        s.frontier[first + b] = uint64_t(1) << b;
+        allPairs.set(first + b, first + b, 0.0f);
+    }
+
+    float d = 0.0f;
+    bool active = true;
+    while (active) {
+        d += w;
+        std::fill(s.next.begin(), s.next.end(), 0);
+        for (size_t u = 0; u < V; ++u) {
+            const uint64_t f = s.frontier[u];
+            if (f == 0)
+                continue;
+            for (size_t k = csr.offsets[u]; k < csr.offsets[u + 1]; ++k)
+                s.next[csr.dst[k]] |= f;
+        }
+
+        active = false;
+        for (size_t v = 0; v < V; ++v) {
+            uint64_t found = s.next[v] & ~s.visited[v];
+            s.frontier[v] = found;
+            if (found == 0)
+                continue;
+            active = true;
+            s.visited[v] |= found;
+            while (found) {
+                size_t src = first + std::countr_zero(found);
+                // the lower triangle of symmetric matrices is written by the other
+                // source, the same count of w additions so the same float
+                if (!allPairs.symmetric() || src <= v)
+                    allPairs.set(src, v, d);
+                found &= found - 1;
+            }
+        }
+    }
+}
+
+// Upper bound on the hop diameter: twice the largest BFS eccentricity of one
+// node per connected component (undirected), V - 1 otherwise
+size_t hopDiameterBound(const GraphCSR& csr) {
+    const size_t V = csr.nodeCount();
+    if (csr.directed || V == 0)
+        return V > 0 ? V - 1 : 0;
+
+    std::vector<int> level(V, -1);
+    std::vector<int> queue;
+    queue.reserve(V);
+    size_t bound = 0;
+    for (size_t root = 0; root < V; ++root) {
+        if (level[root] != -1)
+            continue;
+        level[root] = 0;
+        queue.assign(1, root);
+        for (size_t head = 0; head < queue.size(); ++head) {
+            int u = queue[head];
+            for (int v : csr.neighbors(u)) {
+                if (level[v] == -1) {
+                    level[v] = level[u] + 1;
+                    queue.push_back(v);
+                }
             }
         }
+        bound = std::max<size_t>(bound, 2 * level[queue.back()]);
     }
+    return bound;
 }
 
-std::vector<std::vector<float>> Graph::computeAllPairsShortestPaths() {
+} // namespace
+
+DistanceMatrix Graph::computeAllPairsShortestPaths(bool quantize, const std::atomic<bool>* cancel) const {
     size_t V = nodes.size();
-    std::vector<std::vector<float>> allPairs(V,
-                                             std::vector<float>(V, std::numeric_limits<float>::infinity()));
+    auto cancelled = [&] { return cancel && cancel->load(std::memory_order_relaxed); };
+    GraphCSR csr(*this);
+    const bool symmetric = !directed;
+
+    // Unit (or any uniform) weights: BFS 64 sources at a time
+    const bool uniform = !csr.weight.empty() && csr.weight[0] >= 0.0f &&
+                         std::all_of(csr.weight.begin(), csr.weight.end(),
+                                     [&](float w) { return w == csr.weight[0]; });
+    if (uniform) {
+        const float w = csr.weight[0];
+        auto storage = DistanceMatrix::Storage::Float;
+        if (quantize && w > 0.0f && w == std::floor(w)) {
+            size_t hops = hopDiameterBound(csr);
+            if (hops <= DistanceMatrix::maxHops(DistanceMatrix::Storage::U8))
+                storage = DistanceMatrix::Storage::U8;
+            else if (hops <= DistanceMatrix::maxHops(DistanceMatrix::Storage::U16))
+                storage = DistanceMatrix::Storage::U16;
+        }
+
+        DistanceMatrix allPairs(V, symmetric, storage, w);
+        std::vector<BfsBatch> batches(workerCount());
+        parallelFor((V + 63) / 64, [&](size_t batch, unsigned worker) {
+            if (cancelled())
+                return;
+            bitParallelBfs(csr, batch * 64, w, batches[worker], allPairs);
+        });
+        return allPairs;
+    }
 
-    std::vector<float> dist(V);
-    dist.resize(V);
-    for (size_t i = 0; i < V; ++i) {
-        dijkstra(i, dist);
-        std::copy(dist.begin(), dist.end(), allPairs[i].begin());
+    // One Dijkstra per source, each worker reuses its own row and heap.
+    // Path sums depend on the direction they are added in, except for
+    // integer weights that total below 2^24, so only those keep a single
+    // triangle. Other weights keep full rows, each d(i, j) being the sum
+    // the Dijkstra from i built, as in the serial version.
+    bool integral = true;
+    double total = 0.0;
+    for (float w : csr.weight) {
+        integral = integral && w == std::floor(w);
+        total += w;
     }
+    DistanceMatrix allPairs(V, symmetric && integral && total <= double(1 << 24));
+    std::vector<std::vector<float>> rows(workerCount(), std::vector<float>(V));
+    std::vector<DijkstraHeap> heaps(workerCount());
+    parallelFor(
+        V,
+        [&](size_t i, unsigned worker) {
+            if (cancelled())
+                return;
+            float* dist = rows[worker].data();
+            dijkstra(csr, i, dist, heaps[worker]);
+            for (size_t j = allPairs.symmetric() ? i : 0; j < V; ++j)
+                allPairs.set(i, j, dist[j]);
+        },
+        16);
 
     return allPairs;
 }
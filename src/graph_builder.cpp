@@ -0,0 +1,187 @@
+#include "graph_builder.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <numeric>
+
+namespace {
+
+// Every worker sorts its own range, then neighboring ranges are merged
+template <typename T> void parallelSort(std::vector<T>& v) {
+    const size_t n = v.size();
+    const unsigned workers =
+        parallelRanges(n, [&](size_t begin, size_t end, unsigned) { std::sort(v.begin() + begin, v.begin() + end); });
+    const size_t step = (n + workers - 1) / std::max(workers, 1u);
+    for (size_t width = step; width < n; width *= 2) {
+        const size_t pairs = (n + 2 * width - 1) / (2 * width);
+        parallelFor(pairs, [&](size_t p, unsigned) {
+            size_t begin = p * 2 * width;
+            size_t mid = std::min(begin + width, n);
+            size_t end = std::min(begin + 2 * width, n);
+            std::inplace_merge(v.begin() + begin, v.begin() + mid, v.begin() + end);
+        });
+    }
+}
+
+} // namespace
+
+void GraphBuilder::reserve(size_t edges) {
+    if (parts_.empty())
+        parts_.emplace_back();
+    parts_.back().reserve(edges);
+}
+
+size_t GraphBuilder::edgeCount() const {
+    size_t count = 0;
+    for (const auto& part : parts_)
+        count += part.size();
+    return count;
+}
+
+void GraphBuilder::build(Graph& g) {
+    const size_t E = edgeCount();
+
+    // Fixed size blocks over all parts, the unit of parallel work on edges
+    struct Block {
+        Edge* edges;
+        size_t count;
+    };
+    constexpr size_t BLOCK = 1 << 16;
+    std::vector<Block> blocks;
+    for (auto& part : parts_)
+        for (size_t b = 0; b < part.size(); b += BLOCK)
+            blocks.push_back({part.data() + b, std::min(BLOCK, part.size() - b)});
+    auto forEachBlock = [&](auto&& f) {
+        parallelFor(blocks.size(), [&](size_t i, unsigned worker) { f(blocks[i], worker); });
+    };
+
+    // Id range, declared nodes included
+    std::vector<int> lows(workerCount(), std::numeric_limits<int>::max());
+    std::vector<int> highs(workerCount(), std::numeric_limits<int>::min());
+    forEachBlock([&](const Block& b, unsigned w) {
+        for (size_t i = 0; i < b.count; ++i) {
+            lows[w] = std::min({lows[w], b.edges[i].src, b.edges[i].dst});
+            highs[w] = std::max({highs[w], b.edges[i].src, b.edges[i].dst});
+        }
+    });
+    long lo = *std::min_element(lows.begin(), lows.end());
+    long hi = *std::max_element(highs.begin(), highs.end());
+    if (nodeCount_ > 0) {
+        lo = std::min(lo, 0L);
+        hi = std::max(hi, static_cast<long>(nodeCount_) - 1);
+    }
+
+    // ids[v] is the id of node v, empty while ids are the indices
+    std::vector<int> ids;
+    size_t V = 0;
+    auto remap = [&](auto&& index) {
+        forEachBlock([&](const Block& b, unsigned) {
+            for (size_t i = 0; i < b.count; ++i) {
+                b.edges[i].src = index(b.edges[i].src);
+                b.edges[i].dst = index(b.edges[i].dst);
+            }
+        });
+    };
+
+    if (E == 0 && nodeCount_ == 0) {
+        V = 0;
+    } else if (lo >= 0 && static_cast<size_t>(hi) < nodeCount_) {
+        V = nodeCount_;
+    } else if (lo >= 0 && static_cast<size_t>(hi) < 2 * (2 * E + nodeCount_) + 1024) {
+        // Small non-negative range: flag the ids in use, number them in order
+        std::vector<int> index(hi + 1, 0);
+        std::fill(index.begin(), index.begin() + nodeCount_, 1);
+        forEachBlock([&](const Block& b, unsigned) {
+            for (size_t i = 0; i < b.count; ++i) {
+                std::atomic_ref<int>(index[b.edges[i].src]).store(1, std::memory_order_relaxed);
+                std::atomic_ref<int>(index[b.edges[i].dst]).store(1, std::memory_order_relaxed);
+            }
+        });
+        size_t used = std::count(index.begin(), index.end(), 1);
+        V = used;
+        if (used != index.size()) {
+            ids.reserve(used);
+            for (size_t id = 0; id < index.size(); ++id) {
+                if (index[id]) {
+                    index[id] = ids.size();
+                    ids.push_back(id);
+                }
+            }
+            remap([&](int id) { return index[id]; });
+        }
+    } else {
+        // Sparse or negative ids: sorted distinct ids, found by binary search
+        std::vector<size_t> first(blocks.size() + 1, nodeCount_);
+        for (size_t i = 0; i < blocks.size(); ++i)
+            first[i + 1] = first[i] + 2 * blocks[i].count;
+        ids.resize(first.back());
+        std::iota(ids.begin(), ids.begin() + nodeCount_, 0);
+        parallelFor(blocks.size(), [&](size_t i, unsigned) {
+            int* out = ids.data() + first[i];
+            for (size_t k = 0; k < blocks[i].count; ++k) {
+                *out++ = blocks[i].edges[k].src;
+                *out++ = blocks[i].edges[k].dst;
+            }
+        });
+        parallelSort(ids);
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        V = ids.size();
+        remap([&](int id) { return static_cast<int>(std::lower_bound(ids.begin(), ids.end(), id) - ids.begin()); });
+    }
+
+    // Counting sort by source into one buffer, stable so that the first
+    // weight of a repeated edge stays first
+    const bool both = !g.directed;
+    std::vector<size_t> offsets(V + 1, 0);
+    for (const auto& part : parts_) {
+        for (const Edge& e : part) {
+            if (e.src == e.dst)
+                continue;
+            offsets[e.src + 1]++;
+            if (both)
+                offsets[e.dst + 1]++;
+        }
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    std::vector<NodeAdj> flat(offsets[V]);
+    {
+        std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+        for (auto& part : parts_) {
+            for (const Edge& e : part) {
+                if (e.src == e.dst)
+                    continue;
+                flat[fill[e.src]++] = {e.dst, e.weight};
+                if (both)
+                    flat[fill[e.dst]++] = {e.src, e.weight};
+            }
+            std::vector<Edge>().swap(part);
+        }
+    }
+    parts_.clear();
+    nodeCount_ = 0;
+
+    g.clear();
+    g.nodes.resize(V);
+    g.adj.resize(V);
+    parallelFor(
+        V,
+        [&](size_t v, unsigned) {
+            auto first = flat.begin() + offsets[v];
+            auto last = flat.begin() + offsets[v + 1];
+            std::stable_sort(first, last, [](const NodeAdj& a, const NodeAdj& b) { return a.dst < b.dst; });
+            last = std::unique(first, last, [](const NodeAdj& a, const NodeAdj& b) { return a.dst == b.dst; });
+            g.nodes[v] = Node{ids.empty() ? static_cast<int>(v) : ids[v]};
+            g.adj[v].assign(first, last);
+        },
+        1024);
+
+    if (!ids.empty()) {
+        g.denseIds = false;
+        g.idToIndex.reserve(V);
+        for (size_t v = 0; v < V; ++v)
+            g.idToIndex[ids[v]] = v;
+    }
+    g.topologyVersion = Graph::nextVersion();
+    g.positionVersion = Graph::nextVersion();
+}
@@ -0,0 +1,219 @@
+#include "graph_cache.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+constexpr char MAGIC[8] = "GLCACHE";
+
+size_t padded(size_t bytes) { return (bytes + 7) & ~size_t(7); }
+
+// Integrity check, not a cryptographic hash: four independent lanes over
+// 8-byte words so that hashing keeps up with reading from the page cache
+uint64_t hashBytes(const void* data, size_t n, uint64_t seed) {
+    constexpr uint64_t K0 = 0x9E3779B97F4A7C15ull;
+    constexpr uint64_t K1 = 0xBF58476D1CE4E5B9ull;
+    const char* p = static_cast<const char*>(data);
+    uint64_t lanes[4] = {seed ^ n, seed + K0, seed ^ K1, seed - K0};
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        for (int l = 0; l < 4; ++l) {
+            uint64_t v;
+            std::memcpy(&v, p + i + 8 * l, 8);
+            lanes[l] = std::rotl(lanes[l] ^ (v * K0), 29) * K1;
+        }
+    }
+    uint64_t tail = 0;
+    if (i < n)
+        std::memcpy(&tail, p + i, std::min<size_t>(8, n - i));
+    for (size_t k = i + 8; k < n; k += 8) {
+        uint64_t v = 0;
+        std::memcpy(&v, p + k, std::min<size_t>(8, n - k));
+        tail = std::rotl(tail ^ (v * K0), 29) * K1;
+    }
+    uint64_t h = tail * K0;
+    for (uint64_t lane : lanes)
+        h = std::rotl(h ^ lane, 31) * K1;
+    return h ^ (h >> 32);
+}
+
+struct Section {
+    const void* data;
+    size_t bytes;
+};
+
+uint64_t hashSections(const std::vector<Section>& sections) {
+    uint64_t h = 0;
+    for (const Section& s : sections)
+        h = hashBytes(s.data, s.bytes, h);
+    return h;
+}
+
+} // namespace
+
+GraphCache::GraphCache(const std::string& path) : file_(path) {
+    if (file_.size() < sizeof(Header))
+        throw std::runtime_error("graph cache too small");
+    const Header& h = header();
+    if (std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0)
+        throw std::runtime_error("not a graph cache");
+    if (h.version != VERSION)
+        throw std::runtime_error("graph cache version " + std::to_string(h.version));
+
+    const size_t V = h.nodes;
+    const size_t E = h.edges;
+    const size_t sizes[5] = {
+        8 * (V + 1),
+        4 * E,
+        4 * E,
+        h.flags & IDS ? 4 * V : 0,
+        h.flags & POSITIONS ? 8 * V : 0,
+    };
+    size_t expected = sizeof(Header);
+    for (size_t s : sizes)
+        expected += padded(s);
+    if (file_.size() != expected)
+        throw std::runtime_error("graph cache truncated");
+
+    const char* p = file_.data() + sizeof(Header);
+    std::vector<Section> sections;
+    auto take = [&](size_t bytes) {
+        const char* at = p;
+        p += padded(bytes);
+        sections.push_back({at, bytes});
+        return at;
+    };
+    offsets_ = {reinterpret_cast<const uint64_t*>(take(sizes[0])), V + 1};
+    dst_ = {reinterpret_cast<const int32_t*>(take(sizes[1])), E};
+    weight_ = {reinterpret_cast<const float*>(take(sizes[2])), E};
+    if (sizes[3])
+        ids_ = {reinterpret_cast<const int32_t*>(take(sizes[3])), V};
+    if (sizes[4])
+        xy_ = {reinterpret_cast<const float*>(take(sizes[4])), 2 * V};
+
+    if (hashSections(sections) != h.hash)
+        throw std::runtime_error("graph cache hash mismatch");
+    if (offsets_[0] != 0 || offsets_[V] != E)
+        throw std::runtime_error("graph cache offsets corrupt");
+    // the hash only catches accidents, engines index by these without checks
+    for (size_t v = 0; v < V; ++v)
+        if (offsets_[v] > offsets_[v + 1])
+            throw std::runtime_error("graph cache corrupt");
+    for (int32_t d : dst_)
+        if (d < 0 || static_cast<size_t>(d) >= V)
+            throw std::runtime_error("graph cache corrupt");
+}
+
+void GraphCache::toGraph(Graph& g) const {
+    const size_t V = nodeCount();
+    g.clear();
+    g.directed = directed();
+    g.nodes.resize(V);
+    g.adj.resize(V);
+    parallelFor(
+        V,
+        [&](size_t v, unsigned) {
+            Node& n = g.nodes[v];
+            n = Node{ids_.empty() ? static_cast<int>(v) : ids_[v]};
+            if (!xy_.empty()) {
+                n.x = xy_[2 * v];
+                n.y = xy_[2 * v + 1];
+            }
+            auto& row = g.adj[v];
+            row.resize(offsets_[v + 1] - offsets_[v]);
+            for (size_t e = offsets_[v], k = 0; e < offsets_[v + 1]; ++e, ++k)
+                row[k] = NodeAdj{dst_[e], weight_[e]};
+        },
+        1024);
+
+    if (!ids_.empty()) {
+        g.denseIds = false;
+        g.idToIndex.reserve(V);
+        for (size_t v = 0; v < V; ++v)
+            g.idToIndex[ids_[v]] = v;
+    }
+    g.topologyVersion = Graph::nextVersion();
+    g.positionVersion = Graph::nextVersion();
+}
+
+void GraphCache::write(const Graph& g, const std::string& path, bool positions) {
+    const size_t V = g.nodes.size();
+    std::vector<uint64_t> offsets(V + 1, 0);
+    for (size_t v = 0; v < V; ++v)
+        offsets[v + 1] = offsets[v] + g.adj[v].size();
+    const size_t E = offsets[V];
+
+    std::vector<int32_t> dst(E);
+    std::vector<float> weight(E);
+    parallelFor(
+        V,
+        [&](size_t v, unsigned) {
+            size_t e = offsets[v];
+            for (const NodeAdj& a : g.adj[v]) {
+                dst[e] = a.dst;
+                weight[e++] = a.weight;
+            }
+        },
+        1024);
+
+    std::vector<int32_t> ids;
+    if (!g.denseIds) {
+        ids.resize(V);
+        for (size_t v = 0; v < V; ++v)
+            ids[v] = g.nodes[v].id;
+    }
+    std::vector<float> xy;
+    if (positions) {
+        xy.resize(2 * V);
+        for (size_t v = 0; v < V; ++v) {
+            xy[2 * v] = g.nodes[v].x;
+            xy[2 * v + 1] = g.nodes[v].y;
+        }
+    }
+
+    std::vector<Section> sections = {
+        {offsets.data(), 8 * offsets.size()},
+        {dst.data(), 4 * E},
+        {weight.data(), 4 * E},
+    };
+    if (!ids.empty())
+        sections.push_back({ids.data(), 4 * V});
+    if (!xy.empty())
+        sections.push_back({xy.data(), 8 * V});
+
+    Header h{};
+    std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = VERSION;
+    h.flags = 0;
+    if (g.directed)
+        h.flags |= DIRECTED;
+    if (!ids.empty())
+        h.flags |= IDS;
+    if (!xy.empty())
+        h.flags |= POSITIONS;
+    h.nodes = V;
+    h.edges = E;
+    h.hash = hashSections(sections);
+
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out.is_open())
+            throw std::runtime_error("failed to write " + tmp);
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        const char zeros[8] = {};
+        for (const Section& s : sections) {
+            out.write(static_cast<const char*>(s.data), s.bytes);
+            out.write(zeros, padded(s.bytes) - s.bytes);
+        }
+        if (!out)
+            throw std::runtime_error("failed to write " + tmp);
+    }
+    std::filesystem::rename(tmp, path);
+}
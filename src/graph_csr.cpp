@@ -0,0 +1,34 @@
+#include "graph_csr.hpp"
+
+void GraphCSR::build(const Graph& g, bool canonicalEdges) {
+    const size_t V = g.nodes.size();
+    directed = g.directed;
+    topologyVersion = g.topologyVersion;
+
+    offsets.resize(V + 1);
+    offsets[0] = 0;
+    for (size_t v = 0; v < V; ++v)
+        offsets[v + 1] = offsets[v] + g.adj[v].size();
+
+    dst.resize(offsets[V]);
+    weight.resize(offsets[V]);
+    for (size_t v = 0; v < V; ++v) {
+        size_t k = offsets[v];
+        for (const auto& e : g.adj[v]) {
+            dst[k] = e.dst;
+            weight[k] = e.weight;
+            ++k;
+        }
+    }
+
+    edges.clear();
+    if (!canonicalEdges)
+        return;
+    edges.reserve(directed ? dst.size() : dst.size() / 2);
+    for (size_t v = 0; v < V; ++v) {
+        for (size_t k = offsets[v]; k < offsets[v + 1]; ++k) {
+            if (directed || static_cast<int>(v) <= dst[k])
+                edges.push_back(CanonicalEdge{static_cast<int>(v), dst[k], weight[k]});
+        }
+    }
+}
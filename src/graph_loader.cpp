@@ -0,0 +1,259 @@
+#include "graph_loader.hpp"
+#include "compressed_reader.hpp"
+#include "graph_cache.hpp"
+#include "mapped_file.hpp"
+#include "parallel.hpp"
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using ParsedEdge = GraphBuilder::Edge;
+
+// Files below this size are parsed on the calling thread only
+constexpr size_t MIN_CHUNK_BYTES = 1 << 20;
+
+const char* lineEnd(const char* p, const char* end) {
+    const void* nl = std::memchr(p, '\n', end - p);
+    return nl ? static_cast<const char*>(nl) : end;
+}
+
+const char* nextLine(const char* p, const char* end) {
+    const char* e = lineEnd(p, end);
+    return e < end ? e + 1 : end;
+}
+
+// Parses one integer after optional blanks, like operator>> on one line
+bool parseInt(const char*& p, const char* end, int& value) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        ++p;
+    auto [ptr, ec] = std::from_chars(p, end, value);
+    if (ec != std::errc())
+        return false;
+    p = ptr;
+    return true;
+}
+
+// Splits [begin, end) into up to `parts` ranges that start at a line
+// boundary, returns the parts + 1 boundaries
+std::vector<const char*> splitLines(const char* begin, const char* end, size_t parts) {
+    std::vector<const char*> cuts{begin};
+    const size_t bytes = end - begin;
+    for (size_t i = 1; i < parts; ++i) {
+        const char* p = std::max(begin + bytes * i / parts, cuts.back());
+        if (p >= end)
+            break;
+        cuts.push_back(nextLine(p, end));
+    }
+    cuts.push_back(end);
+    return cuts;
+}
+
+// Runs parseLine(line, lineEnd, edges) on every line of body, spread over
+// the workers in line-aligned chunks. Edges come back per chunk, in order.
+template <typename F>
+std::vector<std::vector<ParsedEdge>> parseBody(const char* begin, const char* end, F&& parseLine) {
+    const size_t bytes = end - begin;
+    const size_t parts = std::max<size_t>(1, std::min<size_t>(4 * workerCount(), bytes / MIN_CHUNK_BYTES));
+    std::vector<const char*> cuts = splitLines(begin, end, parts);
+    const size_t chunks = cuts.size() - 1;
+
+    std::vector<std::vector<ParsedEdge>> edges(chunks);
+    parallelFor(chunks, [&](size_t c, unsigned) {
+        const char* p = cuts[c];
+        const char* last = cuts[c + 1];
+        // about one edge per 8 bytes of text
+        edges[c].reserve((last - p) / 8);
+        while (p < last) {
+            const char* e = lineEnd(p, last);
+            parseLine(p, e, edges[c]);
+            if (e == last)
+                break;
+            p = e + 1;
+        }
+    });
+    return edges;
+}
+
+enum class HeaderState { More, Done, Invalid };
+
+// Compressed files arrive as a stream of line-aligned views, plain ones as
+// a single view over the mapping
+template <typename F> void readText(const std::string& path, F&& onText) {
+    if (isCompressed(path)) {
+        readCompressedLines(path, onText);
+    } else {
+        MappedFile file(path);
+        onText(file.data(), file.data() + file.size());
+    }
+}
+
+// Feeds lines to format.header() while it wants more, p ends up past them
+template <typename Format>
+HeaderState readHeader(Format& format, HeaderState state, const char*& p, const char* end) {
+    while (state == HeaderState::More && p < end) {
+        state = format.header(p, lineEnd(p, end));
+        p = nextLine(p, end);
+    }
+    return state;
+}
+
+template <typename Format> void checkHeader(const std::string& path, const Format& format, HeaderState state) {
+    if (state != HeaderState::Done && !format.optionalHeader())
+        throw std::runtime_error("invalid " + innerExtension(path) + " header in " + path);
+}
+
+// The header lines go to format.header(), the rest of the text to
+// Format::line through parseBody
+template <typename Format> void loadText(Graph& g, const std::string& path, Format& format) {
+    GraphBuilder builder;
+    HeaderState state = HeaderState::More;
+    readText(path, [&](const char* p, const char* end) {
+        state = readHeader(format, state, p, end);
+        if (state != HeaderState::Done)
+            return;
+        for (auto& chunk : parseBody(p, end, Format::line))
+            builder.addEdges(std::move(chunk));
+    });
+    checkHeader(path, format, state);
+    builder.setNodeCount(format.nodeCount());
+    builder.build(g);
+}
+
+// Only the header is parsed, compressed files are still decompressed whole
+template <typename Format> void loadHeader(const std::string& path, Format& format) {
+    HeaderState state = HeaderState::More;
+    readText(path, [&](const char* p, const char* end) { state = readHeader(format, state, p, end); });
+    checkHeader(path, format, state);
+}
+
+// node and edge counts may be spread over the first lines, the rest of the
+// line holding the edge count is skipped
+struct SrcFormat {
+    int counts[2] = {0, 0};
+    int parsed = 0;
+
+    HeaderState header(const char* p, const char* e) {
+        while (parsed < 2) {
+            while (p < e && (*p == ' ' || *p == '\t' || *p == '\r'))
+                ++p;
+            if (p == e)
+                return HeaderState::More;
+            if (!parseInt(p, e, counts[parsed++]))
+                return HeaderState::Invalid;
+        }
+        return HeaderState::Done;
+    }
+    bool optionalHeader() const { return false; }
+    // the counts line is not reliable across .src variants, ids decide
+    size_t nodeCount() const { return 0; }
+
+    // node id, then (weight, neighbor) pairs, the first pair is not an edge
+    static void line(const char* p, const char* e, std::vector<ParsedEdge>& out) {
+        int nodeId, weight, neighbor;
+        if (!parseInt(p, e, nodeId) || !parseInt(p, e, weight) || !parseInt(p, e, neighbor))
+            return;
+        while (parseInt(p, e, weight) && parseInt(p, e, neighbor))
+            out.push_back({nodeId, neighbor, static_cast<float>(weight)});
+    }
+};
+
+// the size line is the first one that is neither empty nor a comment
+struct MtxFormat {
+    int rows = 0, cols = 0;
+
+    HeaderState header(const char* p, const char* e) {
+        if (p == e || *p == '%')
+            return HeaderState::More;
+        if (parseInt(p, e, rows))
+            parseInt(p, e, cols);
+        return HeaderState::Done;
+    }
+    bool optionalHeader() const { return true; }
+    // a n x n matrix has n nodes, also the ones without entries
+    size_t nodeCount() const { return std::max(rows, cols); }
+
+    // 1-based "row col [value]", values are ignored
+    static void line(const char* p, const char* e, std::vector<ParsedEdge>& out) {
+        int r, c;
+        if (p == e || *p == '%' || !parseInt(p, e, r) || !parseInt(p, e, c))
+            return;
+        out.push_back({r - 1, c - 1, 1.0f});
+    }
+};
+
+} // namespace
+
+void loadSotch(Graph& g, const std::string& path) {
+    std::clog << "Load .src file: " << path << "\n";
+    SrcFormat format;
+    loadText(g, path, format);
+}
+
+void loadMtx(Graph& g, const std::string& path) {
+    std::clog << "Load .mtx file: " << path << "\n";
+    MtxFormat format;
+    loadText(g, path, format);
+}
+
+size_t headerNodeCount(const std::string& path) {
+    std::string ext = innerExtension(path);
+    if (ext == ".glc" && !isCompressed(path))
+        return GraphCache(path).nodeCount();
+    if (ext == ".mtx") {
+        MtxFormat format;
+        loadHeader(path, format);
+        return format.nodeCount();
+    }
+    if (ext == ".src") {
+        SrcFormat format;
+        loadHeader(path, format);
+        return std::max(format.counts[0], 0);
+    }
+    throw std::runtime_error("unsupported file type " + ext);
+}
+
+void loadGraphPath(Graph& g, const std::string& path, bool cache) {
+    namespace fs = std::filesystem;
+    std::string ext = innerExtension(path);
+    if (ext == ".glc" && !isCompressed(path)) {
+        std::clog << "Load .glc file: " << path << "\n";
+        GraphCache(path).toGraph(g);
+        return;
+    }
+    if (ext != ".mtx" && ext != ".src")
+        throw std::runtime_error("unsupported file type " + ext);
+
+    const std::string cachePath = path + ".glc";
+    std::error_code ec;
+    if (cache && fs::exists(cachePath, ec) && fs::exists(path, ec) &&
+        fs::last_write_time(cachePath, ec) >= fs::last_write_time(path, ec)) {
+        try {
+            std::clog << "Load cached " << cachePath << "\n";
+            GraphCache(cachePath).toGraph(g);
+            return;
+        } catch (const std::runtime_error& e) {
+            std::clog << "ignoring cache: " << e.what() << "\n";
+        }
+    }
+
+    // throws on a bad file, so only complete graphs reach the cache
+    if (ext == ".mtx")
+        loadMtx(g, path);
+    else
+        loadSotch(g, path);
+
+    if (!cache)
+        return;
+    try {
+        GraphCache::write(g, cachePath);
+    } catch (const std::exception& e) {
+        // read-only directories just do without a cache
+        std::clog << "could not write cache: " << e.what() << "\n";
+    }
+}
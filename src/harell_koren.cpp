@@ -1,59 +1,112 @@
 #include "harell_koren.hpp"
-#include "bin_heap.hpp"
+#include "parallel.hpp"
 #include <algorithm>
-#include <chrono>
 #include <cmath>
 #include <iostream>
 #include <limits>
 #include <random>
 #include <vector>
 
-void HarellKoren::apply(Graph& g) {
+void HarellKoren::init(const Graph& g) {
 
     std::clog << ">> Computing HarellKoren\n";
-    auto start = std::chrono::high_resolution_clock::now();
-
     float L0 = std::max(cfg_.mx, cfg_.my) / 2;
 
-    // PERF: not memory optimized
-    std::clog << "Computing Shortest Paths\n";
-    dist_ = g.computeAllPairsShortestPaths();
+    size_t V = g.nodes.size();
+    state_ = {};
+    work_ = g;
+    if (dist_.size() != V || distVersion_ != g.topologyVersion) {
+        std::clog << "Computing Shortest Paths\n";
+        DistanceMatrix dist = g.computeAllPairsShortestPaths(true, cancel_);
+        checkCancel();
+        dist_ = std::move(dist);
+        distVersion_ = g.topologyVersion;
+    }
 
-    std::clog << "Computing Spring lengths and strenghts\n";
-    computeLAndK(dist_, L0, cfg_.K);
+    float maxDist = dist_.maxFinite();
+    springs_ = SpringModel(dist_, maxDist, L0, cfg_.K, maxDist > 0.0f ? L0 / maxDist : 0.0f);
 
-    size_t V = g.nodes.size();
-    if (V == 0)
-        return;
+    csr_.build(work_);
+    neighborhoods_ = Neighborhoods();
+    centers_.clear();
+    heap_.clear();
+
+    level_ = 0;
+    levelReady_ = false;
+    levelCount_ = 0;
+    for (size_t s = cfg_.min_size; s <= V && levelCount_ < 64; s *= cfg_.ratio)
+        ++levelCount_;
 
-    size_t curr_size_ = cfg_.min_size;
+    levelSize_ = cfg_.min_size;
     std::clog << "Computing Layout\n";
-    while (curr_size_ <= V) {
+    if (levelCount_ > 0)
+        beginLevel();
+}
 
-        std::clog << "K: " << curr_size_ << "\n";
-        std::clog << "Computing KCenters\n";
-        auto centers = kCenters(g, dist_, curr_size_);
+void HarellKoren::beginLevel() {
+    std::clog << "K: " << levelSize_ << "\n";
+    std::clog << "Computing KCenters\n";
+    const auto& centers = kCenters(dist_, levelSize_);
 
-        std::clog << "Computing Radius\n";
-        float radius = computeRadius(centers, dist_, cfg_.rad);
+    std::clog << "Computing Radius\n";
+    float radius = computeRadius(centers, dist_, cfg_.rad);
 
-        std::clog << "Local Layout\n";
-        localLayout(g, dist_, radius);
+    std::clog << "Local Layout\n";
+    int V = work_.nodes.size();
+    const auto& neighborhoods = computeKNeighborhoods(dist_, radius);
+    heap_.resize(V);
+    heap_.clear();
+    for (int v = 0; v < V; ++v) {
+        if (v % 256 == 0)
+            checkCancel();
+        heap_.push(v, computeDeltaK(work_, v, dist_, neighborhoods[v]));
+    }
+    levelIter_ = 0;
+    levelReady_ = true;
 
-        // std::clog << "Add random noise\n";
-        // noise(g, centers, dist_, V);
+    // std::clog << "Add random noise\n";
+    // noise(work_, centers, dist_, V);
+}
 
-        curr_size_ *= cfg_.ratio;
+float HarellKoren::step(int n) {
+    if (converged())
+        return state_.residual;
+    if (!levelReady_) {
+        beginLevel();
+        return state_.residual;
+    }
+    // checked before every move, max_iter = 0 moves nothing
+    const int iters = cfg_.max_iter * static_cast<int>(work_.nodes.size());
+    for (int k = 0; k < n && levelIter_ < iters; ++k) {
+        moveNode(work_, dist_);
+        ++levelIter_;
+        state_.iteration++;
+        state_.residual = heap_.topKey();
+        state_.progress = (level_ + float(levelIter_) / iters) / levelCount_;
+    }
+    if (levelIter_ >= iters) {
+        ++level_;
+        levelSize_ *= cfg_.ratio;
+        levelReady_ = false;
+        state_.progress = float(level_) / levelCount_;
     }
+    return state_.residual;
+}
 
-    auto end = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double> elapsed = end - start;
+bool HarellKoren::converged() const { return level_ >= levelCount_; }
 
-    std::clog << "Elapsed time: " << elapsed.count() << " seconds\n";
+void HarellKoren::store(Graph& g) const {
+    if (g.nodes.size() != work_.nodes.size())
+        return;
+    for (size_t v = 0; v < g.nodes.size(); ++v) {
+        g.nodes[v].x = work_.nodes[v].x;
+        g.nodes[v].y = work_.nodes[v].y;
+    }
+    g.positionVersion = Graph::nextVersion();
 }
 
 void HarellKoren::noise(Graph& g, const std::vector<int>& centers,
-                        const std::vector<std::vector<float>>& dist, const size_t V) {
+                        const DistanceMatrix& dist, const size_t V) {
     std::random_device rd;
 
     std::mt19937 gen(rd());
@@ -63,8 +116,8 @@ void HarellKoren::noise(Graph& g, const std::vector<int>& centers,
         float minDist = std::numeric_limits<float>::max();
         int bestCenter = -1;
         for (int c : centers) {
-            if (dist[v][c] < minDist) {
-                minDist = dist[v][c];
+            if (dist(v, c) < minDist) {
+                minDist = dist(v, c);
                 bestCenter = c;
             }
         }
@@ -72,110 +125,90 @@ void HarellKoren::noise(Graph& g, const std::vector<int>& centers,
         g.nodes[v].y = g.nodes[bestCenter].y + rand(gen);
     }
 }
-void HarellKoren::localLayout(Graph& g, const std::vector<std::vector<float>>& dist, float radius) {
-    int V = g.nodes.size();
-    auto neighborhoods = computeKNeighborhoods(g, dist, radius);
-
-    BinHeap<NodeEnergy> heap(V);
-
-    for (int v = 0; v < V; ++v) {
-        auto delta_en = computeDeltaK(g, v, dist, neighborhoods[v]);
-        heap.push({delta_en.energy, delta_en.dx, delta_en.dy, v});
-    }
-
-    for (int iter = 0; iter < cfg_.max_iter * V; ++iter) {
-
-        if (heap.empty())
-            break;
-
-        const auto &top = heap.top();
-        const int m = top.node;
-        float old_x = g.nodes[m].x;
-        float old_y = g.nodes[m].y;
-
-        float hxx = 0.0f, hyy = 0.0f, hxy = 0.0f;
-        float dx_e = top.dx;
-        float dy_e = top.dy;
+void HarellKoren::moveNode(Graph& g, const DistanceMatrix& dist) {
+    const int m = heap_.topId();
+    NodeEnergy& node_m = heap_.at(m);
+    float old_x = g.nodes[m].x;
+    float old_y = g.nodes[m].y;
+
+    float hxx = 0.0f, hyy = 0.0f, hxy = 0.0f;
+    float dx_e = node_m.dx;
+    float dy_e = node_m.dy;
+
+    for (int i : neighborhoods_[m]) {
+        if (i == m)
+            continue;
 
-        for (int i : neighborhoods[m]) {
-            if (i == m)
-                continue;
+        float dx = g.nodes[m].x - g.nodes[i].x;
+        float dy = g.nodes[m].y - g.nodes[i].y;
+        float dx2 = dx * dx;
+        float dy2 = dy * dy;
+        float d = sqrtf(dx2 + dy2);
+        d = std::max(d, EPSILON);
 
-            float dx = g.nodes[m].x - g.nodes[i].x;
-            float dy = g.nodes[m].y - g.nodes[i].y;
-            float dx2 = dx * dx;
-            float dy2 = dy * dy;
-            float d = sqrtf(dx2 + dy2);
-            d = std::max(d, EPSILON);
-
-            float l_mi = L_[m][i];
-            float k_mi = K_[m][i];
-            float d_mi = dist[m][i];
-
-            float dist3 = d * d * d;
-            hxx += 2 * k_mi * (1 - (l_mi * d_mi * dy2) / dist3);
-            hyy += 2 * k_mi * (1 - (l_mi * d_mi * dx2) / dist3);
-            hxy += 2 * k_mi * l_mi * d_mi * dx * dy / dist3;
-        }
+        float d_mi = dist(m, i);
+        float l_mi = springs_.length(d_mi);
+        float k_mi = springs_.strength(d_mi);
 
-        float det = hxx * hyy - (hxy * hxy);
-        det = std::max(std::abs(det), EPSILON);
-        float delta_x = (-dx_e * hyy + dy_e * hxy) / det;
-        float delta_y = (dx_e * hxy - dy_e * hxx) / det;
+        float dist3 = d * d * d;
+        hxx += 2 * k_mi * (1 - (l_mi * d_mi * dy2) / dist3);
+        hyy += 2 * k_mi * (1 - (l_mi * d_mi * dx2) / dist3);
+        hxy += 2 * k_mi * l_mi * d_mi * dx * dy / dist3;
+    }
 
-        g.nodes[m].x += delta_x;
-        g.nodes[m].y += delta_y;
+    float det = hxx * hyy - (hxy * hxy);
+    det = std::max(std::abs(det), EPSILON);
+    float delta_x = (-dx_e * hyy + dy_e * hxy) / det;
+    float delta_y = (dx_e * hxy - dy_e * hxx) / det;
 
-        auto node_m = heap.get(m);
-        node_m.dx = 0.0f;
-        node_m.dy = 0.0f;
+    g.nodes[m].x += delta_x;
+    g.nodes[m].y += delta_y;
 
-        auto computeContribution = [&](float dx, float dy, float k, float l,
-                                       float d) -> std::pair<float, float> {
-            float dist = std::sqrt(dx * dx + dy * dy);
-            dist = std::max(dist, EPSILON);
-            float factor = 2.0f * k * (1.0f - (l * d) / dist);
-            return {factor * dx, factor * dy};
-        };
+    node_m.dx = 0.0f;
+    node_m.dy = 0.0f;
 
-        for (int u : neighborhoods[m]) {
-            if (u == m)
-                continue;
+    auto computeContribution = [&](float dx, float dy, float k, float l,
+                                   float d) -> std::pair<float, float> {
+        float dist = std::sqrt(dx * dx + dy * dy);
+        dist = std::max(dist, EPSILON);
+        float factor = 2.0f * k * (1.0f - (l * d) / dist);
+        return {factor * dx, factor * dy};
+    };
 
-            auto node_u = heap.get(u);
-            if (node_u.node == -1)
-                throw std::runtime_error("Energy node invalid");
+    for (int u : neighborhoods_[m]) {
+        if (u == m)
+            continue;
 
-            float k_um = K_[u][m];
-            float l_um = L_[u][m];
-            float d_um = dist[u][m];
+        NodeEnergy& node_u = heap_.at(u);
 
-            auto [dx_old_u, dy_old_u] =
-                computeContribution(g.nodes[u].x - old_x, g.nodes[u].y - old_y, k_um, l_um, d_um);
-            node_u.dx -= dx_old_u;
-            node_u.dy -= dy_old_u;
+        float d_um = dist(u, m);
+        float k_um = springs_.strength(d_um);
+        float l_um = springs_.length(d_um);
 
-            auto [dx_new_u, dy_new_u] = computeContribution(g.nodes[u].x - g.nodes[m].x,
-                                                            g.nodes[u].y - g.nodes[m].y, k_um, l_um, d_um);
-            node_u.dx += dx_new_u;
-            node_u.dy += dy_new_u;
+        auto [dx_old_u, dy_old_u] =
+            computeContribution(g.nodes[u].x - old_x, g.nodes[u].y - old_y, k_um, l_um, d_um);
+        node_u.dx -= dx_old_u;
+        node_u.dy -= dy_old_u;
 
-            node_u.energy = sqrtf(node_u.dx * node_u.dx + node_u.dy * node_u.dy);
-            node_u.node = u;
-            heap.update(u, node_u);
+        auto [dx_new_u, dy_new_u] = computeContribution(g.nodes[u].x - g.nodes[m].x,
+                                                        g.nodes[u].y - g.nodes[m].y, k_um, l_um, d_um);
+        node_u.dx += dx_new_u;
+        node_u.dy += dy_new_u;
 
-            auto [dx_m, dy_m] = computeContribution(g.nodes[m].x - g.nodes[u].x, g.nodes[m].y - g.nodes[u].y,
-                                                    K_[m][u], L_[m][u], dist[m][u]);
-            node_m.dx += dx_m;
-            node_m.dy += dy_m;
-        }
+        node_u.energy = sqrtf(node_u.dx * node_u.dx + node_u.dy * node_u.dy);
+        heap_.update(u);
 
-        node_m.energy = sqrtf(node_m.dx * node_m.dx + node_m.dy * node_m.dy);
-        heap.update(m, node_m);
+        auto [dx_m, dy_m] = computeContribution(g.nodes[m].x - g.nodes[u].x, g.nodes[m].y - g.nodes[u].y,
+                                                k_um, l_um, d_um);
+        node_m.dx += dx_m;
+        node_m.dy += dy_m;
     }
+
+    node_m.energy = sqrtf(node_m.dx * node_m.dx + node_m.dy * node_m.dy);
+    heap_.update(m);
 }
-NodeEnergy HarellKoren::computeDeltaK(const Graph& g, int v, const std::vector<std::vector<float>>& dist,
-                                      const std::vector<int>& neighborhood) {
+NodeEnergy HarellKoren::computeDeltaK(const Graph& g, int v, const DistanceMatrix& dist,
+                                      std::span<const int> neighborhood) {
 
     float dx_e = 0.0f;
     float dy_e = 0.0f;
@@ -188,9 +221,9 @@ NodeEnergy HarellKoren::computeDeltaK(const Graph& g, int v, const std::vector<s
         float d = sqrtf(dx * dx + dy * dy);
         d = std::max(d, EPSILON);
 
-        float l_vu = L_[v][u];
-        float k_vu = K_[v][u];
-        float d_vu = dist[v][u];
+        float d_vu = dist(v, u);
+        float l_vu = springs_.length(d_vu);
+        float k_vu = springs_.strength(d_vu);
 
         dx_e += 2 * k_vu * dx * (1 - (l_vu * d_vu) / d);
         dy_e += 2 * k_vu * dy * (1 - (l_vu * d_vu) / d);
@@ -200,95 +233,177 @@ NodeEnergy HarellKoren::computeDeltaK(const Graph& g, int v, const std::vector<s
     return node_en;
 }
 
-std::vector<std::vector<int>>
-HarellKoren::computeKNeighborhoods(const Graph& g, const std::vector<std::vector<float>>& dist, int k) {
-    size_t V = g.nodes.size();
-    std::vector<std::vector<int>> neighborhoods(V);
-
-    for (size_t v = 0; v < V; ++v) {
-        for (size_t u = 0; u < V; ++u) {
-            if (v != u && dist[v][u] < k) {
-                neighborhoods[v].push_back(u);
+namespace {
+
+struct NeighborhoodScratch {
+    std::vector<float> dist;
+    std::vector<char> settled;
+    std::vector<int> touched;
+    Graph::DijkstraHeap heap;
+    // lists of the nodes first, first + 1, ... built by this worker
+    std::vector<int> nodes;
+    size_t first = 0;
+};
+
+// Dijkstra from v truncated at radius k, a plain BFS when all edges weigh
+// the same. The nodes of prev are already settled at their exact distances,
+// so only the frontier around them is explored. Appends prev and then the
+// newly reached nodes in distance order.
+void growNeighborhood(const GraphCSR& csr, const DistanceMatrix& allPairs, bool uniform, int v,
+                      std::span<const int> prev, float k, NeighborhoodScratch& s) {
+    auto visit = [&](int u, float d) {
+        if (!std::isfinite(s.dist[u]))
+            s.touched.push_back(u);
+        s.dist[u] = d;
+    };
+    auto relax = [&](int u) {
+        for (size_t e = csr.offsets[u]; e < csr.offsets[u + 1]; ++e) {
+            int w = csr.dst[e];
+            float alt = s.dist[u] + csr.weight[e];
+            if (s.settled[w] || alt >= k)
+                continue;
+            if (uniform) {
+                // first discovery is the shortest, s.nodes doubles as the queue
+                visit(w, alt);
+                s.settled[w] = 1;
+                s.nodes.push_back(w);
+            } else if (alt < s.dist[w]) {
+                visit(w, alt);
+                if (s.heap.contains(w))
+                    s.heap.update(w, alt);
+                else
+                    s.heap.push(w, alt);
             }
         }
+    };
+
+    visit(v, 0.0f);
+    s.settled[v] = 1;
+    const size_t first = s.nodes.size();
+    for (int u : prev) {
+        visit(u, allPairs(v, u));
+        s.settled[u] = 1;
+        s.nodes.push_back(u);
+    }
+    relax(v);
+    if (uniform) {
+        for (size_t q = first; q < s.nodes.size(); ++q)
+            relax(s.nodes[q]);
+    } else {
+        for (int u : prev)
+            relax(u);
     }
-    return neighborhoods;
-}
-std::vector<int> HarellKoren::kCenters(const Graph& g, const std::vector<std::vector<float>>& dist,
-                                       size_t k) {
-    size_t n = g.nodes.size();
-    std::vector<int> centers;
-    centers.reserve(k);
 
-    std::vector<float> dist_min(n, std::numeric_limits<float>::max());
+    while (!s.heap.empty()) {
+        int u = s.heap.pop();
+        s.settled[u] = 1;
+        s.nodes.push_back(u);
+        relax(u);
+    }
 
-    centers.push_back(0);
-    for (size_t i = 0; i < n; ++i)
-        dist_min[i] = dist[i][0];
+    for (int u : s.touched) {
+        s.dist[u] = std::numeric_limits<float>::infinity();
+        s.settled[u] = 0;
+    }
+    s.touched.clear();
+}
 
-    while (centers.size() < k) {
-        int n_far = -1;
-        float dist_max = -1.0f;
+} // namespace
+
+const Neighborhoods& HarellKoren::computeKNeighborhoods(const DistanceMatrix& dist, int k) {
+    size_t V = csr_.nodeCount();
+    Neighborhoods& nh = neighborhoods_;
+    float radius = static_cast<float>(k);
+
+    if (radius > nh.grown) {
+        // every worker grows a contiguous range of nodes into its own buffer
+        std::vector<NeighborhoodScratch> scratch(workerCount());
+        std::vector<size_t> offsets(V + 1, 0);
+        const bool uniform = std::adjacent_find(csr_.weight.begin(), csr_.weight.end(),
+                                                std::not_equal_to<>()) == csr_.weight.end();
+        parallelRanges(V, [&](size_t begin, size_t end, unsigned worker) {
+            auto& s = scratch[worker];
+            s.dist.assign(V, std::numeric_limits<float>::infinity());
+            s.settled.assign(V, 0);
+            s.heap.resize(V);
+            s.first = begin;
+            for (size_t v = begin; v < end && !cancelled(); ++v) {
+                std::span<const int> prev;
+                if (nh.grown >= 0.0f)
+                    prev = {nh.nodes.data() + nh.offsets[v], nh.offsets[v + 1] - nh.offsets[v]};
+                size_t before = s.nodes.size();
+                growNeighborhood(csr_, dist, uniform, v, prev, radius, s);
+                offsets[v + 1] = s.nodes.size() - before;
+            }
+        });
+        // nh is left as it was, partial lists are never kept
+        checkCancel();
+
+        for (size_t v = 0; v < V; ++v)
+            offsets[v + 1] += offsets[v];
+        std::vector<int> nodes(offsets[V]);
+        for (const auto& s : scratch)
+            std::copy(s.nodes.begin(), s.nodes.end(), nodes.begin() + offsets[s.first]);
+
+        nh.offsets = std::move(offsets);
+        nh.nodes = std::move(nodes);
+        nh.counts.resize(V);
+        for (size_t v = 0; v < V; ++v)
+            nh.counts[v] = nh.offsets[v + 1] - nh.offsets[v];
+        nh.grown = radius;
+        return nh;
+    }
 
-        for (size_t i = 0; i < n; ++i) {
-            if (std::find(centers.begin(), centers.end(), i) != centers.end())
-                continue;
+    // a smaller radius keeps a prefix of each distance ordered list
+    parallelFor(
+        V,
+        [&](size_t v, unsigned) {
+            auto first = nh.nodes.begin() + nh.offsets[v];
+            auto last = nh.nodes.begin() + nh.offsets[v + 1];
+            auto end = std::partition_point(first, last, [&](int u) { return dist(v, u) < radius; });
+            nh.counts[v] = end - first;
+        },
+        256);
+    return nh;
+}
 
-            dist_min[i] = std::min(dist_min[i], dist[i][centers.back()]);
+const std::vector<int>& HarellKoren::kCenters(const DistanceMatrix& dist, size_t k) {
+    size_t n = dist.size();
+    k = std::min(k, n);
+
+    auto addCenter = [&](int c) {
+        centers_.push_back(c);
+        centerDist_[c] = -1.0f;
+    };
+    if (centers_.empty()) {
+        centers_.reserve(k);
+        centerDist_.assign(n, std::numeric_limits<float>::infinity());
+        row_.resize(n);
+        addCenter(0);
+    }
 
-            if (dist_min[i] > dist_max) {
-                dist_max = dist_min[i];
-                n_far = i;
-            }
+    // One round scans n floats, far too little work to start threads for
+    // in each of the k rounds
+    float* dmin = centerDist_.data();
+    const float* row = row_.data();
+    while (centers_.size() < k) {
+        checkCancel();
+        dist.row(centers_.back(), row_.data());
+
+        // farthest node from the centers, the first one on ties
+        float dmax = -1.0f;
+#pragma omp simd reduction(max : dmax)
+        for (size_t i = 0; i < n; ++i) {
+            // centers stay at -1
+            dmin[i] = dmin[i] < 0.0f ? dmin[i] : std::min(dmin[i], row[i]);
+            dmax = std::max(dmax, dmin[i]);
         }
-
-        centers.push_back(n_far);
+        addCenter(std::find(dmin, dmin + n, dmax) - dmin);
     }
 
-    return centers;
+    return centers_;
 }
-void HarellKoren::computeLAndK(const std::vector<std::vector<float>>& dist, float L0, float k) {
-    size_t V = dist.size();
-    L_.assign(V, std::vector<float>(V, 0.0f));
-    K_.assign(V, std::vector<float>(V, 0.0f));
-
-    float maxDist = 0.0f;
-    for (size_t i = 0; i < V; ++i)
-        for (size_t j = 0; j < V; ++j)
-            if (dist[i][j] < std::numeric_limits<float>::infinity())
-                maxDist = std::max(maxDist, dist[i][j]);
-
-    for (size_t i = 0; i < V; ++i)
-        for (size_t j = 0; j < V; ++j) {
-            if (i == j)
-                continue;
-            if (!std::isfinite(dist[i][j])) {
-                L_[i][j] = L0;
-                K_[i][j] = 0.0f;
-            } else {
-                L_[i][j] = L0 * dist[i][j] / maxDist;
-                K_[i][j] = k / (dist[i][j] * dist[i][j]);
-            }
-        }
-    // Debug print
-    // std::clog << "L_ matrix:\n";
-    // for (size_t i = 0; i < V; ++i) {
-    //     for (size_t j = 0; j < V; ++j) {
-    //         std::clog << L_[i][j] << " ";
-    //     }
-    //     std::clog << "\n";
-    // }
-    //
-    // std::clog << "\nK_ matrix:\n";
-    // for (size_t i = 0; i < V; ++i) {
-    //     for (size_t j = 0; j < V; ++j) {
-    //         std::clog << K_[i][j] << " ";
-    //     }
-    //     std::clog << "\n";
-    // }
-}
-
-float HarellKoren::computeRadius(const std::vector<int>& centers, const std::vector<std::vector<float>>& dist,
+float HarellKoren::computeRadius(const std::vector<int>& centers, const DistanceMatrix& dist,
                                  float Rad) {
     float radius = 0.0f;
     for (size_t i = 0; i < centers.size(); ++i) {
@@ -296,7 +411,7 @@ float HarellKoren::computeRadius(const std::vector<int>& centers, const std::vec
         for (size_t j = 0; j < centers.size(); ++j) {
             if (i == j)
                 continue;
-            minDist = std::min(minDist, dist[centers[i]][centers[j]]);
+            minDist = std::min(minDist, dist(centers[i], centers[j]));
         }
         // FIX
         radius = std::max(radius, float(minDist) * Rad);
@@ -305,8 +420,8 @@ float HarellKoren::computeRadius(const std::vector<int>& centers, const std::vec
 }
 
 std::vector<float>
-HarellKoren::computeEnergyDeltaAllNodes(Graph& g, const std::vector<std::vector<float>>& d,
-                                        const std::vector<std::vector<int>>& neighborhoods) {
+HarellKoren::computeEnergyDeltaAllNodes(Graph& g, const DistanceMatrix& d,
+                                        const Neighborhoods& neighborhoods) {
     int V = g.nodes.size();
     std::vector<float> nodeEnergy(V);
     for (int m = 0; m < V; ++m) {
@@ -323,9 +438,9 @@ HarellKoren::computeEnergyDeltaAllNodes(Graph& g, const std::vector<std::vector<
             float dist = sqrtf(dx * dx + dy * dy);
             dist = std::max(dist, EPSILON);
 
-            float l_mi = L_[m][i];
-            float k_mi = K_[m][i];
-            float d_mi = d[m][i];
+            float d_mi = d(m, i);
+            float l_mi = springs_.length(d_mi);
+            float k_mi = springs_.strength(d_mi);
 
             dx_e += 2 * k_mi * dx * (1 - (l_mi * d_mi) / dist);
             dy_e += 2 * k_mi * dy * (1 - (l_mi * d_mi) / dist);
@@ -5,30 +5,53 @@
 #include <limits>
 #include <vector>
 
-void KamadaKawai::apply(Graph& g) {
+void KamadaKawai::init(const Graph& g) {
     std::clog << ">> Computing KamadaKawai\n";
     size_t V = g.nodes.size();
+    state_ = {};
+    buf_.load(g);
     if (V == 0)
         return;
 
+    if (dist_.size() != V || distVersion_ != g.topologyVersion) {
+        DistanceMatrix dist = g.computeAllPairsShortestPaths(true, cancel_);
+        checkCancel();
+        dist_ = std::move(dist);
+        maxDist_ = dist_.maxFinite();
+        distVersion_ = g.topologyVersion;
+    }
     float L0 = std::max(cfg_.mx, cfg_.my) / 2;
-    auto dist = g.computeAllPairsShortestPaths();
-    computeLAndK(dist, L0, cfg_.K);
-    auto en_i = computeEnergy(g);
+    float scale = maxDist_ > 0.0f ? L0 / maxDist_ * cfg_.multL : 0.0f;
+    springs_ = SpringModel(dist_, maxDist_, L0, cfg_.K, scale);
+    d_.resize(V);
+    l_.resize(V);
+    k_.resize(V);
+    auto en_i = computeEnergy();
     std::clog << "Initial Energy: " << en_i << "\n";
 
-    for (int iter = 0; iter < cfg_.max_iter; ++iter) {
+    gx_.resize(V);
+    gy_.resize(V);
+    heap_ = EnergyHeap(V);
+    for (size_t v = 0; v < V; ++v) {
+        if (v % 256 == 0)
+            checkCancel();
+        loadSprings(v);
+        gradient(v, gx_[v], gy_[v]);
+        heap_.push(v, {std::sqrt(gx_[v] * gx_[v] + gy_[v] * gy_[v])});
+    }
+    state_.residual = heap_.topKey();
+}
 
-        // PERF: dont always copy
-        // just return value and index
-        auto nodeEnergy = computeEnergyAllNodes(g);
+float KamadaKawai::step(int n) {
+    const size_t V = buf_.size();
+    float* xs = buf_.xs.data();
+    float* ys = buf_.ys.data();
 
-        auto it = std::max_element(nodeEnergy.begin(), nodeEnergy.end());
-        size_t m = std::distance(nodeEnergy.begin(), it);
-
-        if (*it < EPSILON) {
-            break;
-        }
+    for (int k = 0; k < n && !converged(); ++k) {
+        const size_t m = heap_.topId();
+        const float old_x = xs[m];
+        const float old_y = ys[m];
+        loadSprings(m);
 
         for (int iter_2 = 0; iter_2 < cfg_.max_iter_2; ++iter_2) {
             float hxx = 0.0f;
@@ -36,19 +59,22 @@ void KamadaKawai::apply(Graph& g) {
             float hxy = 0.0f;
             float dx_e = 0.0f;
             float dy_e = 0.0f;
+            const float xm = xs[m];
+            const float ym = ys[m];
+            const float* L = l_.data();
+            const float* K = k_.data();
+            // i == m contributes nothing since its spring has l = k = 0
+#pragma omp simd reduction(+ : hxx, hyy, hxy, dx_e, dy_e)
             for (size_t i = 0; i < V; ++i) {
-                if (i == m)
-                    continue;
-
-                float dx = g.nodes[m].x - g.nodes[i].x;
-                float dy = g.nodes[m].y - g.nodes[i].y;
+                float dx = xm - xs[i];
+                float dy = ym - ys[i];
                 float dx2 = dx * dx;
                 float dy2 = dy * dy;
                 float dist = std::sqrt(dx2 + dy2);
                 dist = std::max(dist, EPSILON);
 
-                float l_mi = L_[m][i];
-                float k_mi = K_[m][i];
+                float l_mi = L[i];
+                float k_mi = K[i];
 
                 float dist3 = dist * dist * dist;
                 hxx += k_mi * (1 - (l_mi * dy2) / dist3);
@@ -65,89 +91,112 @@ void KamadaKawai::apply(Graph& g) {
 
             float delta = std::sqrt(delta_x * delta_x + delta_y * delta_y);
 
-            g.nodes[m].x += delta_x;
-            g.nodes[m].y += delta_y;
+            xs[m] += delta_x;
+            ys[m] += delta_y;
 
             if (delta < EPSILON) {
                 break;
             }
         }
+
+        updateGradients(m, old_x, old_y);
+        for (size_t v = 0; v < V; ++v) {
+            heap_.at(v).energy = std::sqrt(gx_[v] * gx_[v] + gy_[v] * gy_[v]);
+            heap_.update(v);
+        }
+
+        state_.iteration++;
+        state_.progress = float(state_.iteration) / cfg_.max_iter;
+        state_.residual = heap_.topKey();
     }
-    auto en_f = computeEnergy(g);
-    std::clog << "Final Energy: " << en_f << "\n";
+    return state_.residual;
 }
 
-float KamadaKawai::computeEnergy(Graph& g) {
-    size_t V = g.nodes.size();
-    std::vector<float> nodeEnergy(V);
+bool KamadaKawai::converged() const {
+    return buf_.size() == 0 || state_.iteration >= cfg_.max_iter || state_.residual < EPSILON;
+}
+
+void KamadaKawai::store(Graph& g) const { buf_.store(g); }
+
+float KamadaKawai::computeEnergy() {
+    size_t V = buf_.size();
+    const float* xs = buf_.xs.data();
+    const float* ys = buf_.ys.data();
+    const float* L = l_.data();
+    const float* K = k_.data();
     float energy = 0.0f;
     for (size_t m = 0; m < V; ++m) {
-        for (size_t i = 0; i < V; ++i) {
-            if (m <= i) {
-                continue;
-            }
-            float dx = g.nodes[m].x - g.nodes[i].x;
-            float dy = g.nodes[m].y - g.nodes[i].y;
+        if (m % 256 == 0)
+            checkCancel();
+        loadSprings(m);
+#pragma omp simd reduction(+ : energy)
+        for (size_t i = 0; i < m; ++i) {
+            float dx = xs[m] - xs[i];
+            float dy = ys[m] - ys[i];
 
             float dist = std::sqrt(dx * dx + dy * dy);
             dist = std::max(dist, EPSILON);
 
-            float delta = dist - L_[m][i];
-            energy += 0.5f * K_[m][i] * delta * delta;
+            float delta = dist - L[i];
+            energy += 0.5f * K[i] * delta * delta;
         }
     }
     return energy;
 }
-std::vector<float> KamadaKawai::computeEnergyAllNodes(Graph& g) {
-    size_t V = g.nodes.size();
-    std::vector<float> nodeEnergy(V);
-    for (size_t m = 0; m < V; ++m) {
-        float em = 0.0f;
-        float dx_e = 0.0f;
-        float dy_e = 0.0f;
-        for (size_t i = 0; i < V; ++i) {
-            if (m == i) {
-                continue;
-            }
-            float dx = g.nodes[m].x - g.nodes[i].x;
-            float dy = g.nodes[m].y - g.nodes[i].y;
-
-            float dist = std::sqrt(dx * dx + dy * dy);
-            dist = std::max(dist, EPSILON);
-
-            float l_mi = L_[m][i];
-            float k_mi = K_[m][i];
-            dx_e += k_mi * (dx - ((l_mi * dx) / dist));
-            dy_e += k_mi * (dy - ((l_mi * dy) / dist));
-        }
-        em = std::sqrt(dx_e * dx_e + dy_e * dy_e);
-        nodeEnergy[m] = em;
+void KamadaKawai::gradient(size_t m, float& gx, float& gy) const {
+    size_t V = buf_.size();
+    const float* xs = buf_.xs.data();
+    const float* ys = buf_.ys.data();
+    const float* L = l_.data();
+    const float* K = k_.data();
+    float dx_e = 0.0f;
+    float dy_e = 0.0f;
+#pragma omp simd reduction(+ : dx_e, dy_e)
+    for (size_t i = 0; i < V; ++i) {
+        float dx = xs[m] - xs[i];
+        float dy = ys[m] - ys[i];
+
+        float dist = std::sqrt(dx * dx + dy * dy);
+        dist = std::max(dist, EPSILON);
+
+        dx_e += K[i] * (dx - ((L[i] * dx) / dist));
+        dy_e += K[i] * (dy - ((L[i] * dy) / dist));
     }
-    return nodeEnergy;
+    gx = dx_e;
+    gy = dy_e;
 }
 
-void KamadaKawai::computeLAndK(const std::vector<std::vector<float>>& dist, float L0, float k) {
-    size_t V = dist.size();
-    L_.assign(V, std::vector<float>(V, 0.0f));
-    K_.assign(V, std::vector<float>(V, 0.0f));
-
-    float maxDist = 0.0f;
-    for (size_t i = 0; i < V; ++i)
-        for (size_t j = 0; j < V; ++j)
-            if (dist[i][j] < std::numeric_limits<float>::infinity())
-                maxDist = std::max(maxDist, dist[i][j]);
-
-    for (size_t i = 0; i < V; ++i)
-        for (size_t j = 0; j < V; ++j) {
-            if (i == j)
-                continue;
-            if (!std::isfinite(dist[i][j])) {
-                L_[i][j] = L0;
-                K_[i][j] = 0.0f;
-            } else {
-                L_[i][j] = L0 * dist[i][j] / maxDist;
-                L_[i][j] *= cfg_.multL;
-                K_[i][j] = k / (dist[i][j] * dist[i][j]);
-            }
-        }
+void KamadaKawai::updateGradients(size_t m, float old_x, float old_y) {
+    size_t V = buf_.size();
+    const float* xs = buf_.xs.data();
+    const float* ys = buf_.ys.data();
+    float* gx = gx_.data();
+    float* gy = gy_.data();
+    // the springs pulling on the other nodes are column m
+    const float* L = l_.data();
+    const float* K = k_.data();
+    if (!dist_.symmetric()) {
+        lc_.resize(V);
+        kc_.resize(V);
+        springs_.column(dist_, m, lc_.data(), kc_.data());
+        L = lc_.data();
+        K = kc_.data();
+    }
+    const float xm = xs[m];
+    const float ym = ys[m];
+#pragma omp simd
+    for (size_t i = 0; i < V; ++i) {
+        float ox = xs[i] - old_x;
+        float oy = ys[i] - old_y;
+        float od = std::max(std::sqrt(ox * ox + oy * oy), EPSILON);
+        float nx = xs[i] - xm;
+        float ny = ys[i] - ym;
+        float nd = std::max(std::sqrt(nx * nx + ny * ny), EPSILON);
+
+        gx[i] += K[i] * ((nx - (L[i] * nx) / nd) - (ox - (L[i] * ox) / od));
+        gy[i] += K[i] * ((ny - (L[i] * ny) / nd) - (oy - (L[i] * oy) / od));
+    }
+    gradient(m, gx[m], gy[m]);
 }
+
+void KamadaKawai::loadSprings(size_t m) { springs_.row(dist_, m, d_.data(), l_.data(), k_.data()); }
@@ -0,0 +1,176 @@
+#include "layout_executor.hpp"
+#include <iostream>
+
+LayoutExecutor::~LayoutExecutor() { stop(); }
+
+bool LayoutExecutor::busy() const {
+    State s = state();
+    return s == State::Running || s == State::Paused || s == State::Cancelling;
+}
+
+void LayoutExecutor::launch(const Graph& g) {
+    work_ = g;
+    cancel_ = false;
+    paused_ = false;
+    fresh_ = false;
+    discard_ = false;
+    error_.clear();
+    progress_ = 0.0f;
+    lastPublish_ = {};
+    state_ = State::Running;
+    job_->layout().setCancelFlag(&cancel_);
+    worker_ = std::thread(&LayoutExecutor::run, this);
+}
+
+void LayoutExecutor::run() {
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    Layout& layout = job_->layout();
+    try {
+        layout.init(work_);
+
+        // batch size follows the measured cost of a step, so that one batch
+        // takes about one slice whatever the engine and graph size
+        int batch = 1;
+        while (!layout.converged() && proceed()) {
+            auto t0 = clock::now();
+            layout.step(batch);
+            auto spent = clock::now() - t0;
+            if (spent < slice / 2 && batch < (1 << 20))
+                batch *= 2;
+            else if (spent > slice * 2 && batch > 1)
+                batch /= 2;
+
+            progress_.store(layout.state().progress, std::memory_order_relaxed);
+            if (wantsPositions()) {
+                layout.store(work_);
+                publish();
+            }
+        }
+
+        // hand out the final positions even if nobody asked in between
+        layout.store(work_);
+        publish();
+    } catch (const LayoutCancelled&) {
+        // interrupted in the middle of init or a level setup, the engine
+        // holds no positions worth keeping
+    } catch (const std::exception& e) {
+        // e.g. bad_alloc for the V^2 distance matrix of a large graph
+        error_ = e.what();
+        std::clog << "Layout failed: " << error_ << "\n";
+        state_.store(State::Failed, std::memory_order_release);
+        return;
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    bool cancelled = cancel_.load();
+    std::clog << (cancelled ? "Layout cancelled after " : "Layout finished in ") << elapsed.count() << " s\n";
+    if (!cancelled)
+        progress_ = 1.0f;
+    state_.store(cancelled ? State::Cancelled : State::Finished, std::memory_order_release);
+}
+
+void LayoutExecutor::pause() {
+    State running = State::Running;
+    if (state_.compare_exchange_strong(running, State::Paused))
+        paused_ = true;
+}
+
+void LayoutExecutor::resume() {
+    State paused = State::Paused;
+    if (!state_.compare_exchange_strong(paused, State::Running))
+        return;
+    {
+        std::lock_guard lock(pauseMutex_);
+        paused_ = false;
+    }
+    pauseCv_.notify_all();
+}
+
+void LayoutExecutor::cancel(bool keepPositions) {
+    if (!worker_.joinable())
+        return;
+    {
+        std::lock_guard lock(pauseMutex_);
+        cancel_ = true;
+        paused_ = false;
+    }
+    pauseCv_.notify_all();
+    if (!keepPositions) {
+        std::lock_guard lock(swapMutex_);
+        discard_ = true;
+        fresh_ = false;
+    }
+    State s = State::Running;
+    if (!state_.compare_exchange_strong(s, State::Cancelling) && s == State::Paused)
+        state_.compare_exchange_strong(s, State::Cancelling);
+}
+
+void LayoutExecutor::poll() {
+    State s = state();
+    if (worker_.joinable() && (s == State::Finished || s == State::Cancelled || s == State::Failed))
+        worker_.join();
+}
+
+void LayoutExecutor::stop() {
+    if (!worker_.joinable())
+        return;
+    {
+        std::lock_guard lock(pauseMutex_);
+        cancel_ = true;
+        paused_ = false;
+    }
+    pauseCv_.notify_all();
+    worker_.join();
+}
+
+bool LayoutExecutor::collect(Graph& g) {
+    if (!fresh_.load(std::memory_order_acquire))
+        return false;
+    {
+        std::lock_guard lock(swapMutex_);
+        std::swap(ready_, front_);
+        fresh_ = false;
+    }
+    // a snapshot of another graph, e.g. one loaded while the layout ran
+    if (front_.size() != 2 * g.nodes.size())
+        return false;
+    for (size_t i = 0; i < g.nodes.size(); ++i) {
+        g.nodes[i].x = front_[2 * i];
+        g.nodes[i].y = front_[2 * i + 1];
+    }
+    g.positionVersion = Graph::nextVersion();
+    return true;
+}
+
+bool LayoutExecutor::wantsPositions() {
+    if (fresh_.load(std::memory_order_relaxed))
+        return false;
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastPublish_ < interval)
+        return false;
+    lastPublish_ = now;
+    return true;
+}
+
+void LayoutExecutor::publish() {
+    const size_t n = work_.nodes.size();
+    back_.resize(2 * n);
+    for (size_t i = 0; i < n; ++i) {
+        back_[2 * i] = work_.nodes[i].x;
+        back_[2 * i + 1] = work_.nodes[i].y;
+    }
+    std::lock_guard lock(swapMutex_);
+    if (discard_)
+        return;
+    std::swap(back_, ready_);
+    fresh_.store(true, std::memory_order_release);
+}
+
+bool LayoutExecutor::proceed() {
+    if (paused_.load(std::memory_order_relaxed)) {
+        std::unique_lock lock(pauseMutex_);
+        pauseCv_.wait(lock, [&] { return !paused_ || cancel_; });
+    }
+    return !cancel_.load(std::memory_order_relaxed);
+}
@@ -10,6 +10,7 @@
 #include <GLFW/glfw3.h>
 #include <cmath>
 #include <iostream>
+#include <memory>
 
 constexpr float WIDTH = 1440;
 constexpr float HEIGHT = 900;
@@ -26,7 +27,8 @@ int main() {
 
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_COMPAT_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 
     GLFWwindow* window = glfwCreateWindow(WIDTH, HEIGHT, "Graph Layouts", nullptr, nullptr);
     if (!window) {
@@ -52,10 +54,11 @@ int main() {
 
     Graph graph;
     Camera2D camera;
-    Render render(&graph);
+    // owns GL objects, released before the context goes away
+    auto render = std::make_unique<Render>(&graph);
     UIManager ui;
 
-    render.setWindowSize(WIDTH, HEIGHT);
+    render->setWindowSize(WIDTH, HEIGHT);
 
     glfwSetWindowUserPointer(window, &camera);
     glfwSetScrollCallback(window, scrollCallback);
@@ -88,7 +91,7 @@ int main() {
 
 
         // Render graph
-        render.renderGraph(camera, ui.nodeSize);
+        render->renderGraph(camera, ui.nodeSize);
 
         // Render ImGui
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
@@ -96,6 +99,7 @@ int main() {
         glfwSwapBuffers(window);
     }
 
+    render.reset();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -0,0 +1,106 @@
+#include "quadtree.hpp"
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+void QuadTree::build(const float* xs, const float* ys, size_t n) {
+    cells_.clear();
+    xs_.clear();
+    ys_.clear();
+    const int V = n;
+    if (V == 0)
+        return;
+
+    order_.resize(V);
+    std::iota(order_.begin(), order_.end(), 0);
+
+    float minX = std::numeric_limits<float>::max();
+    float minY = std::numeric_limits<float>::max();
+    float maxX = std::numeric_limits<float>::lowest();
+    float maxY = std::numeric_limits<float>::lowest();
+    for (int i = 0; i < V; ++i) {
+        minX = std::min(minX, xs[i]);
+        minY = std::min(minY, ys[i]);
+        maxX = std::max(maxX, xs[i]);
+        maxY = std::max(maxY, ys[i]);
+    }
+    // Square root cell, slightly enlarged so that max coordinates fall inside
+    float size = std::max(maxX - minX, maxY - minY);
+    size = std::max(size * 1.0001f, 1e-3f);
+
+    cells_.reserve(2 * V / std::max(leafSize_, 1) + 1);
+    QuadCell root;
+    root.x0 = minX;
+    root.y0 = minY;
+    root.size = size;
+    root.begin = 0;
+    root.end = V;
+    cells_.push_back(root);
+    buildCell(xs, ys, 0, 0);
+
+    xs_.resize(V);
+    ys_.resize(V);
+    for (int i = 0; i < V; ++i) {
+        xs_[i] = xs[order_[i]];
+        ys_[i] = ys[order_[i]];
+    }
+}
+
+void QuadTree::buildCell(const float* xs, const float* ys, int cell, int depth) {
+    const int begin = cells_[cell].begin;
+    const int end = cells_[cell].end;
+
+    if (end - begin <= leafSize_ || depth >= MAX_DEPTH) {
+        float sx = 0.0f, sy = 0.0f;
+        for (int i = begin; i < end; ++i) {
+            sx += xs[order_[i]];
+            sy += ys[order_[i]];
+        }
+        QuadCell& c = cells_[cell];
+        c.mass = static_cast<float>(end - begin);
+        if (c.mass > 0.0f) {
+            c.cx = sx / c.mass;
+            c.cy = sy / c.mass;
+        }
+        return;
+    }
+
+    const float half = cells_[cell].size * 0.5f;
+    const float midX = cells_[cell].x0 + half;
+    const float midY = cells_[cell].y0 + half;
+
+    // Split [begin, end) into SW, SE, NW, NE
+    auto first = order_.begin();
+    auto south = [&](int i) { return ys[i] < midY; };
+    auto west = [&](int i) { return xs[i] < midX; };
+    int mid = std::partition(first + begin, first + end, south) - first;
+    int sw = std::partition(first + begin, first + mid, west) - first;
+    int nw = std::partition(first + mid, first + end, west) - first;
+    const int bounds[5] = {begin, sw, mid, nw, end};
+
+    const int child = cells_.size();
+    cells_[cell].child = child;
+    for (int k = 0; k < 4; ++k) {
+        QuadCell c;
+        c.x0 = cells_[cell].x0 + ((k & 1) ? half : 0.0f);
+        c.y0 = cells_[cell].y0 + ((k & 2) ? half : 0.0f);
+        c.size = half;
+        c.begin = bounds[k];
+        c.end = bounds[k + 1];
+        cells_.push_back(c);
+    }
+    for (int k = 0; k < 4; ++k)
+        buildCell(xs, ys, child + k, depth + 1);
+
+    float sx = 0.0f, sy = 0.0f, mass = 0.0f;
+    for (int k = 0; k < 4; ++k) {
+        const QuadCell& c = cells_[child + k];
+        sx += c.cx * c.mass;
+        sy += c.cy * c.mass;
+        mass += c.mass;
+    }
+    QuadCell& c = cells_[cell];
+    c.mass = mass;
+    c.cx = sx / mass;
+    c.cy = sy / mass;
+}
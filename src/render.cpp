@@ -1,8 +1,187 @@
 #include "render.hpp"
-#include <GL/gl.h>
+#include <glad/glad.h>
+#include <algorithm>
 #include <cassert>
+#include <stdexcept>
+#include <string>
 
-Render::Render(Graph* g) : graph_(g) {}
+namespace {
+
+// Smaller graphs are always drawn node by node
+constexpr size_t CLUSTER_MIN_NODES = 20'000;
+// Clusters are used while level 0 cells, about one node each, are smaller
+// than this on screen, and are this size at least
+constexpr float CLUSTER_PIXELS = 4.0f;
+// Edges between clusters drawn per cluster sized area of the window
+constexpr float CLUSTER_EDGES_PER_CELL = 0.5f;
+// Least time between two ViewIndex builds for new positions of the same
+// topology, the build and the cluster edge sorts are O(V + E)
+constexpr std::chrono::milliseconds INDEX_REBUILD_INTERVAL{250};
+
+// Camera as a scale and offset into clip space, the same mapping as
+// ortho(0, w, 0, h) * translate(w/2, h/2) * scale(zoom) * translate(-cam)
+constexpr const char* LINE_VS = R"(#version 330 core
+layout(location = 0) in vec2 pos;
+uniform vec2 scale;
+uniform vec2 offset;
+void main() { gl_Position = vec4(pos * scale + offset, 0.0, 1.0); }
+)";
+
+constexpr const char* LINE_FS = R"(#version 330 core
+uniform vec3 color;
+out vec4 fragColor;
+void main() { fragColor = vec4(color, 1.0); }
+)";
+
+// One quad per node: corner is per vertex, center and weight per instance,
+// radius in pixels converted with the viewport size. Clusters scale the
+// disc area with their weight, at least one pixel across like GL_POINTS.
+constexpr const char* POINT_VS = R"(#version 330 core
+layout(location = 0) in vec2 corner;
+layout(location = 1) in vec2 center;
+layout(location = 2) in float weight;
+uniform vec2 scale;
+uniform vec2 offset;
+uniform vec2 pixel;
+uniform float radius;
+out vec2 local;
+void main() {
+    local = corner;
+    float r = max(radius * sqrt(weight), 0.5);
+    gl_Position = vec4(center * scale + offset + corner * r * pixel, 0.0, 1.0);
+}
+)";
+
+constexpr const char* POINT_FS = R"(#version 330 core
+uniform vec3 color;
+in vec2 local;
+out vec4 fragColor;
+void main() {
+    if (dot(local, local) > 1.0)
+        discard;
+    fragColor = vec4(color, 1.0);
+}
+)";
+
+GLuint compileShader(GLenum type, const char* source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+    GLint ok = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        glDeleteShader(shader);
+        throw std::runtime_error(std::string("shader compile failed: ") + log);
+    }
+    return shader;
+}
+
+GLuint linkProgram(const char* vs, const char* fs) {
+    GLuint v = compileShader(GL_VERTEX_SHADER, vs);
+    GLuint f = compileShader(GL_FRAGMENT_SHADER, fs);
+    GLuint program = glCreateProgram();
+    glAttachShader(program, v);
+    glAttachShader(program, f);
+    glLinkProgram(program);
+    glDeleteShader(v);
+    glDeleteShader(f);
+    GLint ok = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+        glDeleteProgram(program);
+        throw std::runtime_error(std::string("shader link failed: ") + log);
+    }
+    return program;
+}
+
+void setCamera(GLuint program, const Camera2D& camera, float w, float h) {
+    float sx = 2.0f * camera.zoom / w;
+    float sy = 2.0f * camera.zoom / h;
+    glUniform2f(glGetUniformLocation(program, "scale"), sx, sy);
+    glUniform2f(glGetUniformLocation(program, "offset"), -camera.x * sx, -camera.y * sy);
+}
+
+} // namespace
+
+Render::Render(Graph* g) : graph_(g) {
+    lineProgram_ = linkProgram(LINE_VS, LINE_FS);
+    pointProgram_ = linkProgram(POINT_VS, POINT_FS);
+
+    GLuint buffers[6];
+    glGenBuffers(6, buffers);
+    positions_ = buffers[0];
+    indices_ = buffers[1];
+    instances_ = buffers[2];
+    clusterLines_ = buffers[3];
+    quad_ = buffers[4];
+    axes_ = buffers[5];
+    GLuint vaos[5];
+    glGenVertexArrays(5, vaos);
+    edgeVao_ = vaos[0];
+    nodeVao_ = vaos[1];
+    clusterVao_ = vaos[2];
+    clusterLineVao_ = vaos[3];
+    axesVao_ = vaos[4];
+
+    // edges: positions indexed by the element buffer, which the VAO keeps
+    glBindVertexArray(edgeVao_);
+    glBindBuffer(GL_ARRAY_BUFFER, positions_);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices_);
+
+    // nodes and clusters: a unit quad per vertex, visible (x, y) or
+    // (x, y, weight) per instance
+    const float corners[] = {-1.f, -1.f, 1.f, -1.f, -1.f, 1.f, 1.f, 1.f};
+    glBindBuffer(GL_ARRAY_BUFFER, quad_);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    for (GLuint vao : {nodeVao_, clusterVao_}) {
+        const bool weighted = vao == clusterVao_;
+        const GLsizei stride = (weighted ? 3 : 2) * sizeof(float);
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, quad_);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+        glBindBuffer(GL_ARRAY_BUFFER, instances_);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, nullptr);
+        glVertexAttribDivisor(1, 1);
+        if (weighted) {
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, stride, (const void*)(2 * sizeof(float)));
+            glVertexAttribDivisor(2, 1);
+        }
+    }
+
+    glBindVertexArray(clusterLineVao_);
+    glBindBuffer(GL_ARRAY_BUFFER, clusterLines_);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+    const float max = 10'000.0f;
+    const float axes[] = {-max, 0.f, max, 0.f, 0.f, -max, 0.f, max};
+    glBindVertexArray(axesVao_);
+    glBindBuffer(GL_ARRAY_BUFFER, axes_);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(axes), axes, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+Render::~Render() {
+    GLuint buffers[] = {positions_, indices_, instances_, clusterLines_, quad_, axes_};
+    glDeleteBuffers(6, buffers);
+    GLuint vaos[] = {edgeVao_, nodeVao_, clusterVao_, clusterLineVao_, axesVao_};
+    glDeleteVertexArrays(5, vaos);
+    glDeleteProgram(lineProgram_);
+    glDeleteProgram(pointProgram_);
+}
 
 void Render::setWindowSize(float w, float h) {
     w_ = w;
@@ -10,68 +189,166 @@ void Render::setWindowSize(float w, float h) {
     glViewport(0, 0, (GLsizei)w, (GLsizei)h);
 }
 
-void Render::applyCameraTransform(const Camera2D& camera) {
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0.0f, w_, 0.0f, h_, -1.0f, 1.0f);
+void Render::syncBuffers() {
+    assert(graph_->nodes.size() == graph_->adj.size());
+    const size_t V = graph_->nodes.size();
 
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+    if (topologyVersion_ != graph_->topologyVersion) {
+        csr_.build(*graph_, true);
+        topologyVersion_ = graph_->topologyVersion;
+        // node count may have changed with the topology
+        positionVersion_ = UINT64_MAX;
+    }
 
-    glTranslatef(w_ * 0.5f, h_ * 0.5f, 0.0f);
-    glScalef(camera.zoom, camera.zoom, 1.0f);
-    glTranslatef(-camera.x, -camera.y, 0.0f);
+    if (positionVersion_ != graph_->positionVersion || nodeCount_ != V) {
+        xy_.resize(2 * V);
+        for (size_t v = 0; v < V; ++v) {
+            xy_[2 * v] = graph_->nodes[v].x;
+            xy_[2 * v + 1] = graph_->nodes[v].y;
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, positions_);
+        const size_t bytes = xy_.size() * sizeof(float);
+        if (bytes > positionCapacity_) {
+            glBufferData(GL_ARRAY_BUFFER, bytes, xy_.data(), GL_DYNAMIC_DRAW);
+            positionCapacity_ = bytes;
+        } else if (bytes > 0) {
+            glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, xy_.data());
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        nodeCount_ = V;
+        positionVersion_ = graph_->positionVersion;
+    }
+
+    // a new topology invalidates the index at once, new positions only
+    // make it less exact, the last ones are picked up once the interval ends
+    const auto now = std::chrono::steady_clock::now();
+    const bool invalid = indexTopology_ != topologyVersion_ || indexNodeCount_ != V;
+    if (invalid || (indexVersion_ != positionVersion_ && now - indexBuilt_ >= INDEX_REBUILD_INTERVAL)) {
+        index_.build(*graph_, csr_);
+        indexVersion_ = positionVersion_;
+        indexTopology_ = topologyVersion_;
+        indexNodeCount_ = V;
+        indexBuilt_ = now;
+    }
 }
 
-void Render::renderEdges() {
-    assert(graph_->nodes.size() == graph_->adj.size());
+int Render::clusterLevel(float zoom) const {
+    if (nodeCount_ < CLUSTER_MIN_NODES)
+        return 0;
+    int level = 0;
+    while (level + 1 < index_.levelCount() && index_.cellSize(level) * zoom < CLUSTER_PIXELS)
+        ++level;
+    return level;
+}
+
+void Render::cull(const Camera2D& camera, float nodeSize) {
+    const CullKey key{camera.x, camera.y, camera.zoom, w_, h_, nodeSize, positionVersion_,
+                      topologyVersion_, indexVersion_};
+    if (culled_ && key == cullKey_)
+        return;
+    cullKey_ = key;
+    culled_ = true;
+
+    // The window in world units, grown by a node radius
+    const float margin = 0.5f * nodeSize;
+    const float hw = 0.5f * w_ / camera.zoom + margin;
+    const float hh = 0.5f * h_ / camera.zoom + margin;
+    const ViewRect view{camera.x - hw, camera.y - hh, camera.x + hw, camera.y + hh};
 
-    glColor3f(1.f, 1.f, 1.f);
-    glBegin(GL_LINES);
-
-    for (size_t i = 0; i < graph_->adj.size(); ++i) {
-        const auto& src = graph_->nodes[i];
-        for (const auto& e : graph_->adj[i]) {
-            if (i <= e.dst) {
-                const auto& dst = graph_->nodes[e.dst];
-                glVertex2f(src.x, src.y);
-                glVertex2f(dst.x, dst.y);
-            }
+    level_ = clusterLevel(camera.zoom);
+    if (level_ == 0) {
+        visibleNodes_.clear();
+        visibleEdges_.clear();
+        index_.query(view, visibleNodes_, visibleEdges_);
+        stream_.resize(2 * visibleNodes_.size());
+        for (size_t i = 0; i < visibleNodes_.size(); ++i) {
+            stream_[2 * i] = xy_[2 * visibleNodes_[i]];
+            stream_[2 * i + 1] = xy_[2 * visibleNodes_[i] + 1];
         }
+        glBindVertexArray(edgeVao_);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, visibleEdges_.size() * sizeof(uint32_t), visibleEdges_.data(),
+                     GL_STREAM_DRAW);
+        glBindVertexArray(0);
+        edgeIndexCount_ = visibleEdges_.size();
+        instanceCount_ = visibleNodes_.size();
+        lineVertexCount_ = 0;
+    } else {
+        const float cellPixels = index_.cellSize(level_) * camera.zoom;
+        const float cells = w_ * h_ / (cellPixels * cellPixels);
+        const auto maxEdges = static_cast<size_t>(CLUSTER_EDGES_PER_CELL * cells);
+        stream_.clear();
+        lines_.clear();
+        index_.queryClusters(view, level_, maxEdges, stream_, lines_);
+        // weights relative to the largest visible cluster
+        float most = 1.0f;
+        for (size_t i = 2; i < stream_.size(); i += 3)
+            most = std::max(most, stream_[i]);
+        for (size_t i = 2; i < stream_.size(); i += 3)
+            stream_[i] /= most;
+        glBindBuffer(GL_ARRAY_BUFFER, clusterLines_);
+        glBufferData(GL_ARRAY_BUFFER, lines_.size() * sizeof(float), lines_.data(), GL_STREAM_DRAW);
+        edgeIndexCount_ = 0;
+        instanceCount_ = stream_.size() / 3;
+        lineVertexCount_ = lines_.size() / 2;
     }
-
-    glEnd();
+    glBindBuffer(GL_ARRAY_BUFFER, instances_);
+    glBufferData(GL_ARRAY_BUFFER, stream_.size() * sizeof(float), stream_.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
-void Render::renderAxes(float max) {
-    glLineWidth(1.5f);
-    glBegin(GL_LINES);
-
-    glColor3f(1.f, 0.f, 0.f);
-    glVertex2f(-max, 0.f);
-    glVertex2f(max, 0.f);
 
-    glColor3f(0.f, 1.f, 0.f);
-    glVertex2f(0.f, -max);
-    glVertex2f(0.f, max);
+void Render::renderEdges() {
+    if (edgeIndexCount_ > 0) {
+        glUniform3f(glGetUniformLocation(lineProgram_, "color"), 1.f, 1.f, 1.f);
+        glBindVertexArray(edgeVao_);
+        glDrawElements(GL_LINES, (GLsizei)edgeIndexCount_, GL_UNSIGNED_INT, nullptr);
+    }
+    if (lineVertexCount_ > 0) {
+        glUniform3f(glGetUniformLocation(lineProgram_, "color"), 0.6f, 0.6f, 0.6f);
+        glBindVertexArray(clusterLineVao_);
+        glDrawArrays(GL_LINES, 0, (GLsizei)lineVertexCount_);
+    }
+}
 
-    glEnd();
+void Render::renderAxes() {
+    glBindVertexArray(axesVao_);
+    glUniform3f(glGetUniformLocation(lineProgram_, "color"), 1.f, 0.f, 0.f);
+    glDrawArrays(GL_LINES, 0, 2);
+    glUniform3f(glGetUniformLocation(lineProgram_, "color"), 0.f, 1.f, 0.f);
+    glDrawArrays(GL_LINES, 2, 2);
 }
+
 void Render::renderNodes(float nodeSize, const Camera2D& camera) {
-    if (nodeSize < 0.1f)
+    if (nodeSize < 0.1f || instanceCount_ == 0)
         return;
-    glPointSize(nodeSize * camera.zoom);
-    glColor3f(1.f, 0.f, 0.f);
-
-    glBegin(GL_POINTS);
-    for (const auto& n : graph_->nodes)
-        glVertex2f(n.x, n.y);
-    glEnd();
+    glUseProgram(pointProgram_);
+    setCamera(pointProgram_, camera, w_, h_);
+    glUniform2f(glGetUniformLocation(pointProgram_, "pixel"), 2.0f / w_, 2.0f / h_);
+    glUniform3f(glGetUniformLocation(pointProgram_, "color"), 1.f, 0.f, 0.f);
+    if (level_ == 0) {
+        // nodeSize * zoom is the diameter in pixels, as glPointSize was
+        glUniform1f(glGetUniformLocation(pointProgram_, "radius"), 0.5f * nodeSize * camera.zoom);
+        glBindVertexArray(nodeVao_);
+        glVertexAttrib1f(2, 1.0f);
+    } else {
+        // the largest cluster fills its cell
+        const float cellPixels = index_.cellSize(level_) * camera.zoom;
+        glUniform1f(glGetUniformLocation(pointProgram_, "radius"), 0.5f * cellPixels);
+        glBindVertexArray(clusterVao_);
+    }
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)instanceCount_);
 }
 
 void Render::renderGraph(const Camera2D& camera, float nodeSize) {
     glDisable(GL_DEPTH_TEST);
-    applyCameraTransform(camera);
-    renderAxes(10'000.0f);
+    syncBuffers();
+    cull(camera, nodeSize);
+
+    glUseProgram(lineProgram_);
+    setCamera(lineProgram_, camera, w_, h_);
+    renderAxes();
     renderEdges();
     renderNodes(nodeSize, camera);
+
+    glBindVertexArray(0);
+    glUseProgram(0);
 }
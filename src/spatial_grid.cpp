@@ -0,0 +1,115 @@
+#include "spatial_grid.hpp"
+#include <cmath>
+#include <limits>
+
+namespace {
+
+struct GridShape {
+    float x0, y0;
+    float cellSize;
+    int cols, rows;
+};
+
+GridShape fitGrid(const float* xs, const float* ys, size_t V, float cellSize, float maxCellsPerNode) {
+    float minX = std::numeric_limits<float>::max();
+    float minY = std::numeric_limits<float>::max();
+    float maxX = std::numeric_limits<float>::lowest();
+    float maxY = std::numeric_limits<float>::lowest();
+    for (size_t i = 0; i < V; ++i) {
+        minX = std::min(minX, xs[i]);
+        minY = std::min(minY, ys[i]);
+        maxX = std::max(maxX, xs[i]);
+        maxY = std::max(maxY, ys[i]);
+    }
+
+    float w = maxX - minX;
+    float h = maxY - minY;
+    cellSize = std::max(cellSize, 1e-3f);
+    const float maxCells = std::max(maxCellsPerNode * static_cast<float>(V), 1.0f);
+    if ((w / cellSize + 1.0f) * (h / cellSize + 1.0f) > maxCells) {
+        cellSize = std::max(cellSize, std::sqrt(w * h / maxCells));
+        while ((w / cellSize + 1.0f) * (h / cellSize + 1.0f) > maxCells)
+            cellSize *= 1.25f;
+    }
+
+    int cols = static_cast<int>(w / cellSize) + 1;
+    int rows = static_cast<int>(h / cellSize) + 1;
+    return GridShape{minX, minY, cellSize, cols, rows};
+}
+
+} // namespace
+
+void SpatialGrid::build(const float* xs, const float* ys, size_t V, float cellSize, float maxCellsPerNode) {
+    items_.clear();
+    if (V == 0)
+        return;
+
+    GridShape shape = fitGrid(xs, ys, V, cellSize, maxCellsPerNode);
+    x0_ = shape.x0;
+    y0_ = shape.y0;
+    cellSize_ = shape.cellSize;
+    cols_ = shape.cols;
+    rows_ = shape.rows;
+
+    // Counting sort of node indices by cell
+    cellStart_.assign(static_cast<size_t>(cols_) * rows_ + 1, 0);
+    cellOf_.resize(V);
+    for (size_t i = 0; i < V; ++i) {
+        int c = cellY(ys[i]) * cols_ + cellX(xs[i]);
+        cellOf_[i] = c;
+        cellStart_[c + 1]++;
+    }
+    for (size_t c = 1; c < cellStart_.size(); ++c)
+        cellStart_[c] += cellStart_[c - 1];
+
+    items_.resize(V);
+    fill_.assign(cellStart_.begin(), cellStart_.end() - 1);
+    for (size_t i = 0; i < V; ++i)
+        items_[fill_[cellOf_[i]]++] = i;
+}
+
+void CellList::build(const float* xs, const float* ys, size_t V, float cellSize, float maxCellsPerNode) {
+    head_.clear();
+    if (V == 0)
+        return;
+
+    GridShape shape = fitGrid(xs, ys, V, cellSize, maxCellsPerNode);
+    x0_ = shape.x0;
+    y0_ = shape.y0;
+    cellSize_ = shape.cellSize;
+    cols_ = shape.cols;
+    rows_ = shape.rows;
+
+    head_.assign(static_cast<size_t>(cols_) * rows_, -1);
+    next_.resize(V);
+    prev_.resize(V);
+    cell_.resize(V);
+    for (size_t i = V; i-- > 0;)
+        link(i, cellY(ys[i]) * cols_ + cellX(xs[i]));
+}
+
+void CellList::move(int i, float x, float y) {
+    int c = cellY(y) * cols_ + cellX(x);
+    if (c == cell_[i])
+        return;
+    unlink(i);
+    link(i, c);
+}
+
+void CellList::link(int i, int c) {
+    cell_[i] = c;
+    prev_[i] = -1;
+    next_[i] = head_[c];
+    if (head_[c] != -1)
+        prev_[head_[c]] = i;
+    head_[c] = i;
+}
+
+void CellList::unlink(int i) {
+    if (prev_[i] != -1)
+        next_[prev_[i]] = next_[i];
+    else
+        head_[cell_[i]] = next_[i];
+    if (next_[i] != -1)
+        prev_[next_[i]] = prev_[i];
+}
@@ -0,0 +1,193 @@
+#include "view_index.hpp"
+#include <numeric>
+
+void ViewIndex::build(const Graph& g, const GraphCSR& csr) {
+    const size_t V = g.nodes.size();
+    levels_.clear();
+    clusterEdges_.clear();
+    clusterEdgesBuilt_.clear();
+    edgeStart_.clear();
+    edgePairs_.clear();
+    if (V == 0)
+        return;
+
+    xs_.resize(V);
+    ys_.resize(V);
+    for (size_t v = 0; v < V; ++v) {
+        xs_[v] = g.nodes[v].x;
+        ys_[v] = g.nodes[v].y;
+    }
+    // the smallest cell size the grid accepts, i.e. about one node per cell
+    grid_.build(xs_.data(), ys_.data(), V, 0.0f, 1.0f);
+
+    Level base{grid_.cols(), grid_.rows(), {}};
+    base.cells.resize(static_cast<size_t>(base.cols) * base.rows);
+    for (size_t v = 0; v < V; ++v) {
+        Cell& c = base.cells[grid_.cellOf(v)];
+        c.bounds.add(xs_[v], ys_[v]);
+        c.count++;
+        c.sumX += xs_[v];
+        c.sumY += ys_[v];
+    }
+
+    // Counting sort of the edges by the cell of their source, cells are
+    // enlarged to cover the edges they hold
+    edgeStart_.assign(base.cells.size() + 1, 0);
+    for (const CanonicalEdge& e : csr.edges)
+        edgeStart_[grid_.cellOf(e.src) + 1]++;
+    std::partial_sum(edgeStart_.begin(), edgeStart_.end(), edgeStart_.begin());
+    edgePairs_.resize(2 * csr.edges.size());
+    std::vector<uint32_t> fill(edgeStart_.begin(), edgeStart_.end() - 1);
+    for (const CanonicalEdge& e : csr.edges) {
+        const int c = grid_.cellOf(e.src);
+        const uint32_t k = fill[c]++;
+        edgePairs_[2 * k] = e.src;
+        edgePairs_[2 * k + 1] = e.dst;
+        base.cells[c].bounds.add(xs_[e.dst], ys_[e.dst]);
+    }
+    levels_.push_back(std::move(base));
+
+    while (levels_.back().cols > 1 || levels_.back().rows > 1) {
+        const Level& fine = levels_.back();
+        Level coarse{(fine.cols + 1) / 2, (fine.rows + 1) / 2, {}};
+        coarse.cells.resize(static_cast<size_t>(coarse.cols) * coarse.rows);
+        for (int y = 0; y < fine.rows; ++y) {
+            for (int x = 0; x < fine.cols; ++x) {
+                const Cell& f = fine.cells[y * fine.cols + x];
+                Cell& c = coarse.cells[(y / 2) * coarse.cols + x / 2];
+                c.bounds.add(f.bounds);
+                c.count += f.count;
+                c.sumX += f.sumX;
+                c.sumY += f.sumY;
+            }
+        }
+        levels_.push_back(std::move(coarse));
+    }
+    clusterEdges_.resize(levels_.size());
+    clusterEdgesBuilt_.assign(levels_.size(), false);
+}
+
+template <typename F> void ViewIndex::forEachCell(const ViewRect& view, int level, F&& f) const {
+    if (levels_.empty())
+        return;
+    struct Item {
+        int level, x, y;
+    };
+    std::vector<Item> stack{{levelCount() - 1, 0, 0}};
+    while (!stack.empty()) {
+        const Item it = stack.back();
+        stack.pop_back();
+        const Level& lv = levels_[it.level];
+        const int c = it.y * lv.cols + it.x;
+        // empty cells have inverted bounds and never intersect
+        if (!lv.cells[c].bounds.intersects(view))
+            continue;
+        if (it.level == level) {
+            f(c);
+            continue;
+        }
+        const Level& below = levels_[it.level - 1];
+        for (int dy = 0; dy < 2; ++dy) {
+            for (int dx = 0; dx < 2; ++dx) {
+                const int x = 2 * it.x + dx;
+                const int y = 2 * it.y + dy;
+                if (x < below.cols && y < below.rows)
+                    stack.push_back({it.level - 1, x, y});
+            }
+        }
+    }
+}
+
+void ViewIndex::query(const ViewRect& view, std::vector<uint32_t>& nodes,
+                      std::vector<uint32_t>& edges) const {
+    forEachCell(view, 0, [&](int c) {
+        for (int v : grid_.cell(c))
+            if (view.contains(xs_[v], ys_[v]))
+                nodes.push_back(v);
+        for (uint32_t k = edgeStart_[c]; k < edgeStart_[c + 1]; ++k) {
+            const uint32_t a = edgePairs_[2 * k];
+            const uint32_t b = edgePairs_[2 * k + 1];
+            ViewRect bounds;
+            bounds.add(xs_[a], ys_[a]);
+            bounds.add(xs_[b], ys_[b]);
+            if (bounds.intersects(view)) {
+                edges.push_back(a);
+                edges.push_back(b);
+            }
+        }
+    });
+}
+
+void ViewIndex::buildClusterEdges(int level) {
+    const Level& lv = levels_[level];
+    const int baseCols = levels_[0].cols;
+    auto cellAt = [&](uint32_t v) {
+        const int c = grid_.cellOf(v);
+        return ((c / baseCols) >> level) * lv.cols + ((c % baseCols) >> level);
+    };
+
+    // (a, b) cell pairs as sortable keys, counted by runs
+    std::vector<uint64_t> keys;
+    keys.reserve(edgePairs_.size() / 2);
+    for (size_t k = 0; k < edgePairs_.size(); k += 2) {
+        int a = cellAt(edgePairs_[k]);
+        int b = cellAt(edgePairs_[k + 1]);
+        if (a == b)
+            continue;
+        if (a > b)
+            std::swap(a, b);
+        keys.push_back(static_cast<uint64_t>(a) << 32 | static_cast<uint32_t>(b));
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<ClusterEdge>& out = clusterEdges_[level];
+    out.clear();
+    for (size_t i = 0; i < keys.size();) {
+        size_t j = i;
+        while (j < keys.size() && keys[j] == keys[i])
+            ++j;
+        out.push_back({static_cast<int>(keys[i] >> 32), static_cast<int>(keys[i] & 0xFFFFFFFFu),
+                       static_cast<uint32_t>(j - i)});
+        i = j;
+    }
+    std::stable_sort(out.begin(), out.end(),
+                     [](const ClusterEdge& a, const ClusterEdge& b) { return a.count > b.count; });
+    clusterEdgesBuilt_[level] = true;
+}
+
+void ViewIndex::queryClusters(const ViewRect& view, int level, size_t maxEdges, std::vector<float>& glyphs,
+                              std::vector<float>& lines) {
+    if (levels_.empty())
+        return;
+    level = std::clamp(level, 0, levelCount() - 1);
+    const Level& lv = levels_[level];
+    auto centroid = [&](int c, float& x, float& y) {
+        const Cell& cell = lv.cells[c];
+        x = static_cast<float>(cell.sumX / cell.count);
+        y = static_cast<float>(cell.sumY / cell.count);
+    };
+
+    forEachCell(view, level, [&](int c) {
+        float x, y;
+        centroid(c, x, y);
+        glyphs.insert(glyphs.end(), {x, y, static_cast<float>(lv.cells[c].count)});
+    });
+
+    if (!clusterEdgesBuilt_[level])
+        buildClusterEdges(level);
+    size_t emitted = 0;
+    for (const ClusterEdge& e : clusterEdges_[level]) {
+        if (emitted == maxEdges)
+            break;
+        float ax, ay, bx, by;
+        centroid(e.a, ax, ay);
+        centroid(e.b, bx, by);
+        ViewRect bounds;
+        bounds.add(ax, ay);
+        bounds.add(bx, by);
+        if (!bounds.intersects(view))
+            continue;
+        lines.insert(lines.end(), {ax, ay, bx, by});
+        ++emitted;
+    }
+}
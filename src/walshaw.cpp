@@ -1,81 +1,285 @@
 #include "walshaw.hpp"
+#include <algorithm>
 #include <iostream>
+#include <numeric>
+#include <random>
 
-// TODO: coarsening
-void Walshaw::apply(Graph& g) {
-
-    std::clog << ">> Computing Wallshaw\n";
+// Heavy edge matching: every unmatched node, visited in random order, is
+// collapsed with the unmatched neighbor sharing the heaviest edge (ties go
+// to the lighter neighbor). Returns false if the graph barely shrinks.
+bool Walshaw::coarsen(const Graph& g, const std::vector<float>& w, Graph& coarse,
+                      std::vector<float>& coarseW, std::vector<int>& parent) {
     const size_t V = g.nodes.size();
-    if (V == 0) {
-        return;
+    std::vector<int> order(V);
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937 gen(V);
+    std::shuffle(order.begin(), order.end(), gen);
+
+    csr_.build(g);
+    parent.assign(V, -1);
+    coarseW.clear();
+    for (int v : order) {
+        if (parent[v] != -1)
+            continue;
+
+        int best = -1;
+        float bestEdge = 0.0f;
+        for (size_t k = csr_.offsets[v]; k < csr_.offsets[v + 1]; ++k) {
+            int u = csr_.dst[k];
+            float ew = csr_.weight[k];
+            if (u == v || parent[u] != -1)
+                continue;
+            if (best == -1 || ew > bestEdge || (ew == bestEdge && w[u] < w[best])) {
+                best = u;
+                bestEdge = ew;
+            }
+        }
+
+        parent[v] = coarseW.size();
+        float weight = w[v];
+        if (best != -1) {
+            parent[best] = parent[v];
+            weight += w[best];
+        }
+        coarseW.push_back(weight);
     }
-    float A = cfg_.mx * cfg_.my;
-    float K = cfg_.C * std::sqrt(A / static_cast<float>(V));
-    float T = K;
+
+    const size_t CV = coarseW.size();
+    if (CV == V || CV > 0.95f * V)
+        return false;
+
+    coarse.clear();
+    coarse.directed = g.directed;
+    for (size_t c = 0; c < CV; ++c)
+        coarse.addNode(c);
+
+    // Merge parallel edges by summing their weights
+    std::vector<int> members(V);
+    std::vector<int> start(CV + 1, 0);
+    for (size_t v = 0; v < V; ++v)
+        start[parent[v] + 1]++;
+    std::partial_sum(start.begin(), start.end(), start.begin());
+    std::vector<int> fill(start.begin(), start.end() - 1);
+    for (size_t v = 0; v < V; ++v)
+        members[fill[parent[v]]++] = v;
+
+    std::vector<int> slot(CV, -1);
+    for (size_t c = 0; c < CV; ++c) {
+        auto& row = coarse.adj[c];
+        for (int k = start[c]; k < start[c + 1]; ++k) {
+            const int v = members[k];
+            for (size_t e = csr_.offsets[v]; e < csr_.offsets[v + 1]; ++e) {
+                int cu = parent[csr_.dst[e]];
+                if (cu == static_cast<int>(c))
+                    continue;
+                if (slot[cu] == -1) {
+                    slot[cu] = row.size();
+                    row.push_back(NodeAdj{cu, csr_.weight[e]});
+                } else {
+                    row[slot[cu]].weight += csr_.weight[e];
+                }
+            }
+        }
+        for (const auto& e : row)
+            slot[e.dst] = -1;
+    }
+    return true;
+}
+
+void Walshaw::buildHierarchy(const Graph& g) {
+    levels_.clear();
+    weights_.clear();
+    parents_.clear();
+
+    std::vector<float> w(g.nodes.size(), 1.0f);
+    const Graph* fine = &g;
+    while (static_cast<int>(fine->nodes.size()) > cfg_.min_size) {
+        Graph coarse;
+        std::vector<float> coarseW;
+        std::vector<int> parent;
+        if (!coarsen(*fine, w, coarse, coarseW, parent))
+            break;
+
+        parents_.push_back(std::move(parent));
+        weights_.push_back(coarseW);
+        levels_.push_back(std::move(coarse));
+        fine = &levels_.back();
+        w = std::move(coarseW);
+    }
+}
+
+void Walshaw::placeCoarseNodes() {
+    for (size_t l = 0; l < levels_.size(); ++l) {
+        const Graph& fine = levelGraph(l);
+        const std::vector<float>& w = levelWeights(l);
+        Graph& coarse = levels_[l];
+        for (auto& c : coarse.nodes)
+            c.x = c.y = 0.0f;
+        for (size_t v = 0; v < fine.nodes.size(); ++v) {
+            Node& c = coarse.nodes[parents_[l][v]];
+            c.x += fine.nodes[v].x * w[v];
+            c.y += fine.nodes[v].y * w[v];
+        }
+        for (size_t c = 0; c < coarse.nodes.size(); ++c) {
+            coarse.nodes[c].x /= weights_[l][c];
+            coarse.nodes[c].y /= weights_[l][c];
+        }
+    }
+}
+
+void Walshaw::beginLevel(size_t l, float K) {
+    level_ = l;
+    levelK_ = K;
+    levelIter_ = 0;
+    T_ = K;
     R_ = 20 * K;
+    Graph& g = levelGraph(l);
+    std::clog << "Level " << l << ": " << g.nodes.size() << " nodes\n";
+    csr_.build(g);
+    buf_.load(g);
+}
+
+float Walshaw::sweep() {
+    const size_t V = buf_.size();
+    const float K = levelK_;
+    const std::vector<float>& weight = levelWeights(level_);
+    float* xs = buf_.xs.data();
+    float* ys = buf_.ys.data();
 
-    bool converged = 0;
-    int iter = 0;
+    if (levelIter_ % 100 == 0) {
+        std::clog << "Iter: " << levelIter_ << '\n';
+        std::clog << "T: " << T_ << '\n';
+    }
+
+    float maxMove = 0.0f;
+    // Only nodes within R_ repel, cells of size R_ are kept in sync with the sweep
+    cells_.build(xs, ys, V, R_);
+    for (size_t i = 0; i < V; i++) {
+        float thetaX = 0.0f;
+        float thetaY = 0.0f;
 
-    while (!converged && iter < cfg_.max_iter) {
+        // Repulsive
+        cells_.forEachNeighbor(xs[i], ys[i], [&](int j) {
+            if (static_cast<int>(i) == j)
+                return;
 
-        if (iter % 100 == 0) {
-            std::clog << "Iter: " << iter << '\n';
-            std::clog << "T: " << T << '\n';
+            float dx = xs[j] - xs[i];
+            float dy = ys[j] - ys[i];
+            float dist = std::sqrt(dx * dx + dy * dy + EPSILON);
+            float force = fg(dist, weight[j], K);
+            thetaX += (dx / dist) * force;
+            thetaY += (dy / dist) * force;
+        });
+
+        // Attractive
+        for (int j : csr_.neighbors(i)) {
+            float dx = xs[j] - xs[i];
+            float dy = ys[j] - ys[i];
+            float dist = std::sqrt(dx * dx + dy * dy + EPSILON);
+            float force = fa(dist, K);
+            thetaX += (dx / dist) * force;
+            thetaY += (dy / dist) * force;
         }
 
-        converged = 1;
-        for (size_t i = 0; i < V; i++) {
-            Node& v = g.nodes[i];
-            float thetaX = 0.0f;
-            float thetaY = 0.0f;
+        float oldPosX = xs[i];
+        float oldPosY = ys[i];
 
-            // Repulsive
-            for (size_t j = 0; j < V; j++) {
-                if (i == j)
-                    continue;
+        float disp = std::sqrt(thetaX * thetaX + thetaY * thetaY + EPSILON);
+        float step = std::min(disp, T_);
+        xs[i] += (thetaX / disp) * step;
+        ys[i] += (thetaY / disp) * step;
+        cells_.move(i, xs[i], ys[i]);
 
-                const Node& u = g.nodes[j];
+        float dx = oldPosX - xs[i];
+        float dy = oldPosY - ys[i];
+        float dist2 = dx * dx + dy * dy;
+        maxMove = std::max(maxMove, std::sqrt(std::max(dist2, EPSILON)));
+    }
+    levelIter_++;
+    T_ = cool(T_);
+    return maxMove;
+}
 
-                float dx = u.x - v.x;
-                float dy = u.y - v.y;
-                float dist = std::sqrt(dx * dx + dy * dy + EPSILON);
-                float w = 1.0f;
-                float force = fr(dist, w, K, cfg_.C);
-                thetaX += (dx / dist) * force;
-                thetaY += (dy / dist) * force;
-            }
+void Walshaw::init(const Graph& g) {
 
-            // Attractive
-            for (const auto& n_a : g.adj[i]) {
-                const Node& u = g.nodes[n_a.dst];
-                float dx = u.x - v.x;
-                float dy = u.y - v.y;
-                float dist = std::sqrt(dx * dx + dy * dy + EPSILON);
-                float force = fa(dist, K);
-                thetaX += (dx / dist) * force;
-                thetaY += (dy / dist) * force;
-            }
+    std::clog << ">> Computing Wallshaw\n";
+    const size_t V = g.nodes.size();
+    state_ = {};
+    done_ = V == 0;
+    if (done_)
+        return;
 
-            float oldPosX = v.x;
-            float oldPosY = v.y;
+    // fine_ keeps the adjacency of the last input, a warm start with the
+    // same topology only needs the positions
+    if (fine_.topologyVersion != g.topologyVersion || fine_.nodes.size() != V) {
+        fine_ = g;
+    } else {
+        for (size_t v = 0; v < V; ++v) {
+            fine_.nodes[v].x = g.nodes[v].x;
+            fine_.nodes[v].y = g.nodes[v].y;
+        }
+    }
+    if (hierarchyVersion_ != g.topologyVersion || hierarchyMinSize_ != cfg_.min_size ||
+        fineWeights_.size() != V || (!parents_.empty() && parents_[0].size() != V)) {
+        buildHierarchy(g);
+        hierarchyVersion_ = g.topologyVersion;
+        hierarchyMinSize_ = cfg_.min_size;
+    }
+    fineWeights_.assign(V, 1.0f);
+    placeCoarseNodes();
+    const size_t L = levels_.size();
+    std::clog << "Levels: " << L + 1 << '\n';
+
+    // Natural spring length grows by sqrt(7/4) per coarser level
+    float A = cfg_.mx * cfg_.my;
+    float K = cfg_.C * std::sqrt(A / static_cast<float>(V));
+    const float shrink = std::sqrt(4.0f / 7.0f);
+    beginLevel(L, K / std::pow(shrink, static_cast<float>(L)));
+}
 
-            float disp = std::sqrt(thetaX * thetaX + thetaY * thetaY + EPSILON);
-            float step = std::min(disp, T);
-            v.x += (thetaX / disp) * step;
-            v.y += (thetaY / disp) * step;
+float Walshaw::step(int n) {
+    const size_t L = levels_.size();
+    for (int k = 0; k < n && !done_; ++k) {
+        state_.residual = sweep();
+        state_.iteration++;
+        state_.progress = (L - level_ + float(levelIter_) / cfg_.max_iter) / (L + 1);
 
-            float dx = oldPosX - v.x;
-            float dy = oldPosY - v.y;
-            float dist2 = dx * dx + dy * dy;
-            float dist = std::sqrt(std::max(dist2, EPSILON));
+        if (state_.residual > levelK_ * cfg_.tol && levelIter_ < cfg_.max_iter)
+            continue;
 
-            if (dist > K * cfg_.tol)
-                converged = 0;
+        std::clog << "Final T: " << T_ << '\n';
+        std::clog << "Final Iter: " << levelIter_ << '\n';
+        Graph& coarse = levelGraph(level_);
+        buf_.store(coarse);
+        if (level_ == 0) {
+            done_ = true;
+            break;
         }
-        iter++;
-        T = cool(T);
+
+        // Interpolate: children start at their parent's position
+        Graph& fine = levelGraph(level_ - 1);
+        for (size_t v = 0; v < fine.nodes.size(); ++v) {
+            const Node& p = coarse.nodes[parents_[level_ - 1][v]];
+            fine.nodes[v].x = p.x;
+            fine.nodes[v].y = p.y;
+        }
+        beginLevel(level_ - 1, levelK_ * std::sqrt(4.0f / 7.0f));
+    }
+    return state_.residual;
+}
+
+bool Walshaw::converged() const { return done_; }
+
+void Walshaw::store(Graph& g) const {
+    if (g.nodes.size() != fine_.nodes.size())
+        return;
+    // Nodes of the input follow their ancestor on the current level
+    for (size_t v = 0; v < g.nodes.size(); ++v) {
+        size_t u = v;
+        for (size_t l = 0; l < level_; ++l)
+            u = parents_[l][u];
+        g.nodes[v].x = buf_.xs[u];
+        g.nodes[v].y = buf_.ys[u];
     }
-    std::clog << "Final T: " << T << '\n';
-    std::clog << "Final Iter: " << iter << '\n';
+    g.positionVersion = Graph::nextVersion();
 }